@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "pico/stdlib.h"
 #include "tube-client.h"
 #include "tube-defs.h"
 #include "tube.h"
@@ -20,24 +21,501 @@
 #include "programs.h"
 #include "copro-65tube.h"
 
+// The 6502 runs a block of THROTTLE_BLOCK_US worth of cycles at full speed,
+// then waits here for the wall clock to reach the end of the block. So the
+// average speed is copro_speed MHz, at the cost of some burstiness.
+#define THROTTLE_BLOCK_US 1000
+
+// If the 6502 gets this far behind (e.g. with the core stalled), stop trying to catch up
+#define THROTTLE_RESYNC_US 100000
+
+copro_65tube_throttle_t copro_65tube_throttle_stats;
+
+int copro_65tube_cycle_budget;
+
+static uint32_t throttle_start_us;
+static uint32_t throttle_block_end_us;
+static uint32_t throttle_lost_us;
+
+static void copro_65tube_throttle_reset(void) {
+   memset(&copro_65tube_throttle_stats, 0, sizeof(copro_65tube_throttle_stats));
+   throttle_lost_us = 0;
+   throttle_start_us = throttle_block_end_us = time_us_32();
+   copro_65tube_cycle_budget = 0;
+   copro_65tube_throttle();
+}
+
+// Called from slowdown (copro-65tubeasmM0.S) when the cycle budget runs out
+void __time_critical_func(copro_65tube_throttle)(void) {
+   copro_65tube_throttle_t *t = &copro_65tube_throttle_stats;
+   unsigned int block = copro_speed * THROTTLE_BLOCK_US;
+   if (!block) {
+      // Full speed
+      copro_65tube_cycle_budget = 0x40000000;
+      return;
+   }
+   if (t->cycles) {
+      int32_t late;
+      t->blocks++;
+      throttle_block_end_us += THROTTLE_BLOCK_US;
+      late = time_us_32() - throttle_block_end_us;
+      if (late > t->max_late_us) {
+         t->max_late_us = late;
+      }
+      if (late > THROTTLE_RESYNC_US) {
+         t->resyncs++;
+         throttle_lost_us += late;
+         throttle_block_end_us += late;
+      }
+      while ((int32_t)(time_us_32() - throttle_block_end_us) < 0);
+   }
+   copro_65tube_cycle_budget += block;
+   t->cycles += block;
+}
+
+static void copro_65tube_throttle_report(void) {
+   copro_65tube_throttle_t *t = &copro_65tube_throttle_stats;
+   uint64_t cycles;
+   uint32_t elapsed;
+   if (!copro_speed || !t->cycles) {
+      return;
+   }
+   // Drift is how far behind (+ve) or ahead the 6502 is of copro_speed MHz
+   cycles = t->cycles - copro_65tube_cycle_budget;
+   elapsed = time_us_32() - throttle_start_us - throttle_lost_us;
+   LOG_INFO("Throttle %uMHz: %"PRIu64" cycles in %"PRIu32"us, drift %"PRId32"us, %"PRIu32" blocks, max late %"PRId32"us, %"PRIu32" resyncs\r\n",
+             copro_speed, cycles, elapsed, (int32_t)(elapsed - cycles / copro_speed),
+             t->blocks, t->max_late_us, t->resyncs);
+}
+
+#ifdef PROFILE6502
+uint32_t copro_65tube_profile[256];
+
+int copro_65tube_profile_enabled;
+
+int copro_65tube_profile_dump_pending;
+
+#define PROFILE_TOP 16
+
+static void copro_65tube_profile_dump(void) {
+   static uint32_t counts[256];
+   uint64_t total = 0;
+   int i, j;
+   LOG_INFO("6502 opcode profile\r\n");
+   for (i = 0; i < 256; i++) {
+      counts[i] = copro_65tube_profile[i];
+      total += counts[i];
+      if ((i & 7) == 0) {
+         LOG_INFO("%02x:", i);
+      }
+      LOG_INFO(" %10"PRIu32, counts[i]);
+      if ((i & 7) == 7) {
+         LOG_INFO("\r\n");
+      }
+   }
+   LOG_INFO("Total %"PRIu64" instructions, top opcodes:\r\n", total);
+   for (i = 0; i < PROFILE_TOP && total; i++) {
+      int top = 0;
+      for (j = 1; j < 256; j++) {
+         if (counts[j] > counts[top]) {
+            top = j;
+         }
+      }
+      if (!counts[top]) {
+         break;
+      }
+      LOG_INFO("%02x %10"PRIu32" %5.2f%%\r\n", top, counts[top], 100.0 * counts[top] / total);
+      counts[top] = 0;
+   }
+}
+#endif
+
+#ifdef PROFILE6502_PC
+#include "hardware/structs/systick.h"
+#include "hardware/regs/m0plus.h"
+
+// Samples per second
+#define PC_PROFILE_HZ 10000
+
+copro_65tube_pc_profile_t copro_65tube_pc_profile;
+
+int copro_65tube_pc_profile_dump_pending;
+
+// Memory of the running 6502, or NULL
+static uint8_t *volatile pc_profile_mem;
+
+void __time_critical_func(copro_65tube_pc_sample)(uint8_t *pc, uint8_t *mem) {
+   copro_65tube_pc_profile_t *p = &copro_65tube_pc_profile;
+   // rPC has moved past the opcode, as in trace6502code
+   uint32_t addr = pc - mem - 1;
+   if (mem != pc_profile_mem || addr > 0xFFFF) {
+      p->outside++;
+      return;
+   }
+   p->pages[addr >> 8]++;
+   int slot = (addr ^ (addr >> 9)) & (PC_PROFILE_HOT - 1);
+   if (p->hot[slot].addr == addr) {
+      if (p->hot[slot].count < INT16_MAX) {
+         p->hot[slot].count++;
+      }
+   } else if (--p->hot[slot].count <= 0) {
+      p->hot[slot].addr = addr;
+      p->hot[slot].count = 1;
+   }
+}
+
+void copro_65tube_pc_profile_start(void) {
+   // Lowest priority, so the tube interrupts are never held up by sampling
+   hw_set_bits((io_rw_32 *)(PPB_BASE + M0PLUS_SHPR3_OFFSET), M0PLUS_SHPR3_PRI_15_BITS);
+   systick_hw->rvr = arm_speed * (1000000 / PC_PROFILE_HZ) - 1;
+   systick_hw->cvr = 0;
+   systick_hw->csr = 7;
+}
+
+void copro_65tube_pc_profile_stop(void) {
+   systick_hw->csr = 5;
+}
+
+#define PC_PROFILE_TOP 16
+
+static void copro_65tube_pc_profile_dump(void) {
+   copro_65tube_pc_profile_t *p = &copro_65tube_pc_profile;
+   static int16_t counts[PC_PROFILE_HOT];
+   uint32_t total = 0;
+   int i, j;
+   LOG_INFO("6502 PC profile (samples per page)\r\n");
+   for (i = 0; i < 256; i++) {
+      total += p->pages[i];
+      if ((i & 7) == 0) {
+         LOG_INFO("%02x00:", i);
+      }
+      LOG_INFO(" %8"PRIu32, p->pages[i]);
+      if ((i & 7) == 7) {
+         LOG_INFO("\r\n");
+      }
+   }
+   LOG_INFO("%"PRIu32" samples in the 6502, %"PRIu32" outside, hot addresses:\r\n", total, p->outside);
+   for (i = 0; i < PC_PROFILE_HOT; i++) {
+      counts[i] = p->hot[i].count;
+   }
+   for (i = 0; i < PC_PROFILE_TOP && total; i++) {
+      int top = 0;
+      for (j = 1; j < PC_PROFILE_HOT; j++) {
+         if (counts[j] > counts[top]) {
+            top = j;
+         }
+      }
+      if (counts[top] <= 0) {
+         break;
+      }
+      LOG_INFO("%04x %6d\r\n", p->hot[top].addr, counts[top]);
+      counts[top] = 0;
+   }
+}
+#endif
+
+#ifdef TRACE6502
+#ifdef TRACE6502_SYSTICK
+#include "hardware/structs/systick.h"
+#include "hardware/regs/m0plus.h"
+#endif
+
+// The instruction trace ring (see trace6502code in copro-65tubeasmM0.S)
+//
+// Copro command 13 sets it up for the next tube reset, and dumps it there.
+// A trigger is set up in the Co Pro memory, little endian:
+//
+// +0 PC to trigger at (&FFFF for none)
+// +2 instruction count to trigger at, 4 bytes (0 for none)
+// +6 tube events to trigger on (1 IRQ, 2 NMI, 4 RST, 0 for none)
+// +7 records to take after the trigger, 2 bytes
+//
+// With no trigger it records until stopped, keeping the last TRACE6502_RING.
+
+copro_65tube_trace_t copro_65tube_trace;
+
+static copro_65tube_trace_record_t trace_ring[TRACE6502_RING];
+
+enum { TRACE_STOP, TRACE_START, TRACE_DUMP };
+
+// What to do at the next tube reset: the core owns copro_65tube_trace while it runs
+static int trace_start_pending = -1;
+static int trace_dump_pending;
+static copro_65tube_trace_t trace_setup;
+
+void copro_65tube_trace_command(uint8_t val) {
+   copro_65tube_trace_t *t = &trace_setup;
+   const uint8_t *m = mpu_memory + (val << 8);
+   if (val == TRACE_DUMP) {
+      trace_dump_pending = 1;
+      return;
+   }
+   memset(t, 0, sizeof(*t));
+   t->trigger_pc = 0xFFFFFFFF;
+   if (val > TRACE_DUMP) {
+      uint32_t pc = m[0] | (m[1] << 8);
+      if (pc != 0xFFFF) {
+         t->trigger_pc = pc;
+      }
+      t->trigger_count = m[2] | (m[3] << 8) | (m[4] << 16) | ((uint32_t) m[5] << 24);
+      t->trigger_events = m[6] & (IRQ_BIT | NMI_BIT | RESET_BIT);
+      t->post = m[7] | (m[8] << 8);
+      val = TRACE_START;
+   }
+   trace_start_pending = val;
+}
+
+// P as PHP would push it without B
+static uint8_t copro_65tube_trace_p(const copro_65tube_trace_record_t *r) {
+   return (r->nz > 0xFF ? 0x80 : 0) | 0x20 | r->vdi | ((r->nz & 0xFF) ? 0 : 0x02) | (r->c & 1);
+}
+
+static void copro_65tube_trace_dump(const uint8_t *mem) {
+   const copro_65tube_trace_t *t = &copro_65tube_trace;
+   uint32_t n = t->count < TRACE6502_RING ? t->count : TRACE6502_RING;
+   uint32_t first = t->count - n;
+#ifdef TRACE6502_SYSTICK
+   uint32_t last_ticks = 0;
+#endif
+   LOG_INFO("6502 trace: %"PRIu32" instructions, the last %"PRIu32" recorded", t->count, n);
+   if (t->triggered) {
+      LOG_INFO(", triggered at %"PRIu32" (*)", t->triggered);
+   }
+   // The operands are as the memory is now
+   LOG_INFO("\r\n     instr  PC  op operands A  X  Y  P  SP\r\n");
+   for (uint32_t i = first; i < t->count; i++) {
+      const copro_65tube_trace_record_t *r = &trace_ring[i % TRACE6502_RING];
+      LOG_INFO("%10"PRIu32"%c %04x %02x %02x %02x  %02x %02x %02x %02x %02x",
+               i + 1, i + 1 == t->triggered ? '*' : ' ', r->pc, r->opcode,
+               mem[(uint16_t) (r->pc + 1)], mem[(uint16_t) (r->pc + 2)],
+               r->a, r->x, r->y, copro_65tube_trace_p(r), r->sp);
+#ifdef TRACE6502_SYSTICK
+      uint32_t ticks = r->systick[0] | (r->systick[1] << 8) | (r->systick[2] << 16);
+      if (i > first) {
+         // SysTick counts down
+         LOG_INFO(" +%"PRIu32, (last_ticks - ticks) & 0xFFFFFF);
+      }
+      last_ticks = ticks;
+#endif
+      LOG_INFO("\r\n");
+   }
+}
+
+// Called while the 6502 core is stopped for a tube reset
+static void copro_65tube_trace_reset(const uint8_t *mem) {
+   copro_65tube_trace_t *t = &copro_65tube_trace;
+   if (trace_dump_pending) {
+      trace_dump_pending = 0;
+      copro_65tube_trace_dump(mem);
+   }
+   if (trace_start_pending == TRACE_STOP) {
+      t->next = NULL;
+   } else if (trace_start_pending == TRACE_START) {
+      *t = trace_setup;
+      memset(trace_ring, 0, sizeof(trace_ring));
+      t->start = t->next = trace_ring;
+      t->end = trace_ring + TRACE6502_RING;
+#ifdef TRACE6502_SYSTICK
+      // Count through all 24 bits, unless the PC profiler is using SysTick
+      if (!(systick_hw->csr & M0PLUS_SYST_CSR_TICKINT_BITS)) {
+         systick_hw->rvr = 0xFFFFFF;
+      }
+#endif
+   }
+   trace_start_pending = -1;
+}
+#endif
+
+#ifdef COPRO_SNAPSHOT
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+// A snapshot is taken when the 6502 core stops for a tube reset, while the
+// ULA is still as the 6502 left it (tube_wait_for_rst_release() resets it),
+// and is restored once RST has been released. It covers the copro and not
+// the host, so restoring one under a freshly reset BBC suits work that is
+// busy in the copro rather than part way through talking to the host.
+//
+// The saved one lives in the top of the flash, a sector for the header then
+// the memory, and is copied back from XIP. Writing it takes the flash (and
+// so interrupts) away for the best part of a second.
+
+#define SNAPSHOT_MEM_SIZE     0x10000
+#define SNAPSHOT_FLASH_SIZE   (FLASH_SECTOR_SIZE + SNAPSHOT_MEM_SIZE)
+#define SNAPSHOT_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - SNAPSHOT_FLASH_SIZE)
+#define SNAPSHOT_FLASH        ((const copro_65tube_snapshot_t *) (XIP_BASE + SNAPSHOT_FLASH_OFFSET))
+#define SNAPSHOT_FLASH_MEM    ((const uint8_t *) (XIP_BASE + SNAPSHOT_FLASH_OFFSET + FLASH_SECTOR_SIZE))
+
+// Bytes per line when streaming over the UART (read by host/copro-snapshot.c)
+#define SNAPSHOT_LINE 32
+
+copro_65tube_regs_t copro_65tube_regs;
+
+int copro_65tube_resume;
+
+int copro_65tube_snapshot_pending;
+
+static void copro_65tube_snapshot_take(copro_65tube_snapshot_t *s, const uint8_t *mem) {
+   memset(s, 0, sizeof(*s));
+   s->magic = COPRO_SNAPSHOT_MAGIC;
+   s->version = COPRO_SNAPSHOT_VERSION;
+   s->header_size = sizeof(*s);
+   s->copro = copro;
+   s->copro_speed = copro_speed;
+   s->mem_sum = copro_65tube_snapshot_sum(mem, SNAPSHOT_MEM_SIZE);
+   s->regs = copro_65tube_regs;
+   tube_ula_save(&s->ula);
+}
+
+static void copro_65tube_snapshot_save(const copro_65tube_snapshot_t *s, const uint8_t *mem) {
+   static uint8_t page[FLASH_PAGE_SIZE];
+   uint32_t ints;
+   memset(page, 0xff, sizeof(page));
+   memcpy(page, s, sizeof(*s));
+#ifdef USE_ULA_CORE
+   tube_ula_core_park(1);
+#endif
+   ints = save_and_disable_interrupts();
+   flash_range_erase(SNAPSHOT_FLASH_OFFSET, SNAPSHOT_FLASH_SIZE);
+   flash_range_program(SNAPSHOT_FLASH_OFFSET, page, FLASH_PAGE_SIZE);
+   flash_range_program(SNAPSHOT_FLASH_OFFSET + FLASH_SECTOR_SIZE, mem, SNAPSHOT_MEM_SIZE);
+   restore_interrupts(ints);
+#ifdef USE_ULA_CORE
+   tube_ula_core_park(0);
+#endif
+}
+
+// Returns the snapshot in the flash, or NULL if there isn't a good one
+static const copro_65tube_snapshot_t *copro_65tube_snapshot_saved(void) {
+   const copro_65tube_snapshot_t *s = SNAPSHOT_FLASH;
+   if (s->magic != COPRO_SNAPSHOT_MAGIC || s->version != COPRO_SNAPSHOT_VERSION || s->header_size != sizeof(*s)) {
+      LOG_WARN("No snapshot in flash\r\n");
+      return NULL;
+   }
+   if (s->mem_sum != copro_65tube_snapshot_sum(SNAPSHOT_FLASH_MEM, SNAPSHOT_MEM_SIZE)) {
+      LOG_WARN("Snapshot in flash has a bad checksum\r\n");
+      return NULL;
+   }
+   return s;
+}
+
+static void copro_65tube_snapshot_line(uint32_t offset, const uint8_t *data, uint32_t len) {
+   for (uint32_t i = 0; i < len; i += SNAPSHOT_LINE) {
+      LOG_INFO("%05"PRIx32":", offset + i);
+      for (uint32_t j = i; j < i + SNAPSHOT_LINE && j < len; j++) {
+         LOG_INFO("%02x", data[j]);
+      }
+      LOG_INFO("\r\n");
+   }
+}
+
+static void copro_65tube_snapshot_stream(const copro_65tube_snapshot_t *s, const uint8_t *mem) {
+   LOG_INFO("SNAPSHOT %u\r\n", (unsigned int) (sizeof(*s) + SNAPSHOT_MEM_SIZE));
+   copro_65tube_snapshot_line(0, (const uint8_t *) s, sizeof(*s));
+   copro_65tube_snapshot_line(sizeof(*s), mem, SNAPSHOT_MEM_SIZE);
+   LOG_INFO("SNAPSHOT END\r\n");
+}
+
+// Called when the 6502 core has stopped for a tube reset
+static void copro_65tube_snapshot_exit(const uint8_t *mem) {
+   static copro_65tube_snapshot_t snapshot;
+   const copro_65tube_snapshot_t *s;
+   switch (copro_65tube_snapshot_pending) {
+   case COPRO_SNAPSHOT_SAVE:
+      copro_65tube_snapshot_take(&snapshot, mem);
+      copro_65tube_snapshot_save(&snapshot, mem);
+      LOG_INFO("Snapshot of copro %"PRIu32" at PC %04"PRIx32" saved\r\n", snapshot.copro, snapshot.regs.pc);
+      break;
+   case COPRO_SNAPSHOT_STREAM:
+      copro_65tube_snapshot_take(&snapshot, mem);
+      copro_65tube_snapshot_stream(&snapshot, mem);
+      break;
+   case COPRO_SNAPSHOT_SHOW:
+      s = copro_65tube_snapshot_saved();
+      if (s) {
+         copro_65tube_snapshot_stream(s, SNAPSHOT_FLASH_MEM);
+      }
+      break;
+   default:
+      // Restoring happens in copro_65tube_reset()
+      return;
+   }
+   copro_65tube_snapshot_pending = 0;
+}
+
+// Returns the snapshot to restore at this reset, with its memory queued, or NULL
+static const copro_65tube_snapshot_t *copro_65tube_snapshot_restore(void) {
+   const copro_65tube_snapshot_t *s = NULL;
+   if (copro_65tube_snapshot_pending == COPRO_SNAPSHOT_RESTORE) {
+      copro_65tube_snapshot_pending = 0;
+      s = copro_65tube_snapshot_saved();
+      if (s) {
+         copro_mem_copy(0, SNAPSHOT_FLASH_MEM, SNAPSHOT_MEM_SIZE);
+      }
+   }
+   return s;
+}
+#endif
+
+copro_65tube_reset_timing_t copro_65tube_reset_timing;
+
+static uint32_t reset_start_us;
+static int reset_poweron;
+
 static unsigned char *copro_65tube_poweron_reset(void) {
+   reset_start_us = time_us_32();
+   reset_poweron = 1;
    // Wipe memory
    unsigned char * mpu_memory;
    mpu_memory = copro_mem_reset(0xf800); // only need to goto 0xF800 as rom will be put in later
    // Install test programs (like sphere)
-   copy_test_programs(mpu_memory);
+   copy_test_programs();
+#ifdef BCD_TABLES
+   bcd_tables_init();
+#endif
    return mpu_memory;
 }
 
-static void copro_65tube_reset(unsigned char mpu_memory[]) {
+static void copro_65tube_reset(void) {
+   copro_65tube_reset_timing_t *t = &copro_65tube_reset_timing;
+   uint32_t released;
+#ifdef COPRO_SNAPSHOT
+   const copro_65tube_snapshot_t *restore;
+#endif
+   if (!reset_poweron) {
+      reset_start_us = time_us_32();
+   }
    // Re-instate the Tube ROM on reset
-   if (copro == COPRO_65TUBE_0 || copro == COPRO_65TUBE_1) {
-      memcpy(mpu_memory + 0xf800, tuberom_6502_extern_1_10, 0x800);
+   if (copro == COPRO_65TUBE_0 || copro == COPRO_65TUBE_1 || copro == COPRO_65TUBE_C) {
+      copro_mem_copy(0xf800, tuberom_6502_extern_1_10, 0x800);
    } else {
-      memcpy(mpu_memory + 0xf800, tuberom_6502_intern_1_10, 0x800);
+      copro_mem_copy(0xf800, tuberom_6502_intern_1_10, 0x800);
    }
+#ifdef COPRO_SNAPSHOT
+   // Or all of the memory from a snapshot
+   restore = copro_65tube_snapshot_restore();
+#endif
+   // With COPRO_MEM_DMA, the memory set up runs while RST is debounced
+   copro_mem_start();
    // Wait for rst become inactive before continuing to execute
    tube_wait_for_rst_release();
+   released = time_us_32();
+   copro_mem_wait();
+   t->copro = copro;
+   t->poweron = reset_poweron;
+   t->rst_us = released - reset_start_us;
+   t->mem_us = time_us_32() - released;
+   reset_poweron = 0;
+   LOG_DEBUG("Copro %u %s ready in %"PRIu32"us: RST released after %"PRIu32"us, memory %"PRIu32"us later\r\n",
+             t->copro, t->poweron ? "power on" : "reset", t->rst_us + t->mem_us, t->rst_us, t->mem_us);
+#ifdef COPRO_SNAPSHOT
+   copro_65tube_resume = restore != NULL;
+   if (restore) {
+      tube_ula_restore(&restore->ula);
+      copro_65tube_regs = restore->regs;
+      LOG_INFO("Snapshot of copro %"PRIu32" restored at PC %04"PRIx32"\r\n", restore->copro, restore->regs.pc);
+   }
+#endif
 }
 
 void copro_65tube_emulator() {
@@ -49,13 +527,62 @@ void copro_65tube_emulator() {
    // that flag events from the ISR using the ip register
 
    mpu_memory = copro_65tube_poweron_reset();
-   copro_65tube_reset(mpu_memory);
+   copro_65tube_reset();
 
    while (copro == last_copro) {
 
+#ifdef PROFILE6502_PC
+      pc_profile_mem = mpu_memory;
+#endif
       // Copro 0/2 runs at full speed, Copro 1/3 run at specified slower speed
-      exec_65tube(mpu_memory, (copro == COPRO_65TUBE_1 || copro == COPRO_65TUBE_3) ? 1 : 0);
+      if (copro == COPRO_65TUBE_1 || copro == COPRO_65TUBE_3) {
+         copro_65tube_throttle_reset();
+         exec_65tube(mpu_memory, 1);
+         copro_65tube_throttle_report();
+      } else {
+         exec_65tube(mpu_memory, 0);
+      }
+#ifdef COPRO_SNAPSHOT
+      copro_65tube_snapshot_exit(mpu_memory);
+#endif
+#ifdef TRACE6502
+      copro_65tube_trace_reset(mpu_memory);
+#endif
+#ifdef PROFILE6502_PC
+      pc_profile_mem = NULL;
+      if (copro_65tube_pc_profile_dump_pending) {
+         copro_65tube_pc_profile_dump_pending = 0;
+         copro_65tube_pc_profile_dump();
+      }
+#endif
+#ifdef PROFILE6502
+      if (copro_65tube_profile_dump_pending) {
+         copro_65tube_profile_dump_pending = 0;
+         copro_65tube_profile_dump();
+      }
+#endif
+
+      copro_65tube_reset();
+   }
+}
 
-      copro_65tube_reset(mpu_memory);
+// The same 65C02 on the C core, as a reference for the assembler one
+void copro_65tubec_emulator() {
+   int last_copro = copro;
+   unsigned char * mpu_memory;
+
+   mpu_memory = copro_65tube_poweron_reset();
+   copro_65tube_reset();
+
+   while (copro == last_copro) {
+      exec_65tubec(mpu_memory, 0);
+#ifdef TUBE_HLE
+      LOG_DEBUG("native Tube ROM calls: %lu\r\n", (unsigned long) copro_65tubec_hle_calls);
+      copro_65tubec_hle_calls = 0;
+#endif
+#ifdef COPRO_SNAPSHOT
+      copro_65tube_snapshot_exit(mpu_memory);
+#endif
+      copro_65tube_reset();
    }
 }
@@ -2,8 +2,190 @@
 #ifndef COPRO_65TUBE_H
 #define COPRO_65TUBE_H
 
+#include <inttypes.h>
+
 extern void copro_65tube_emulator();
 
+// Throttling for the speed limited copros (1/3)
+typedef struct {
+   uint64_t cycles;      // 6502 cycles granted
+   uint32_t blocks;      // times the budget ran out
+   uint32_t resyncs;     // times the 6502 fell too far behind to catch up
+   int32_t max_late_us;  // furthest behind the wall clock at the end of a block
+} copro_65tube_throttle_t;
+
+extern copro_65tube_throttle_t copro_65tube_throttle_stats;
+
+extern int copro_65tube_cycle_budget;
+
+extern void copro_65tube_throttle(void);
+
+// The last reset of a 65tube copro, in us from the start of the reset (when
+// it was switched to, or the 6502 saw RST) until RST was released and
+// debounced, then until memory was ready (with COPRO_MEM_DMA)
+typedef struct {
+   uint32_t copro;
+   uint32_t poweron;     // memory was wiped and the test programs copied
+   uint32_t rst_us;
+   uint32_t mem_us;
+} copro_65tube_reset_timing_t;
+
+extern copro_65tube_reset_timing_t copro_65tube_reset_timing;
+
+#ifdef PROFILE6502
+// Opcode profiler (see profile_table in copro-65tubeasmM0.S)
+extern uint32_t copro_65tube_profile[256];
+
+// Set to profile the fast copros (0/2) from the next tube reset
+extern int copro_65tube_profile_enabled;
+
+// Set to dump the counts over the UART at the next tube reset
+extern int copro_65tube_profile_dump_pending;
+#endif
+
+#ifdef PROFILE6502_PC
+// PC sampling profiler (see isr_systick in copro-65tubeasmM0.S)
+#define PC_PROFILE_HOT 512
+
+typedef struct {
+   uint32_t pages[256];  // samples per 6502 page
+   uint32_t outside;     // samples with the 6502 core not running, or in C code it called
+   struct {
+      uint16_t addr;
+      int16_t count;     // majority vote within the slot, so hot addresses stay put
+   } hot[PC_PROFILE_HOT];
+} copro_65tube_pc_profile_t;
+
+extern copro_65tube_pc_profile_t copro_65tube_pc_profile;
+
+extern void copro_65tube_pc_sample(uint8_t *pc, uint8_t *mem);
+
+extern void copro_65tube_pc_profile_start(void);
+
+extern void copro_65tube_pc_profile_stop(void);
+
+// Set to dump the samples over the UART at the next tube reset
+extern int copro_65tube_pc_profile_dump_pending;
+#endif
+
+#ifdef TRACE6502
+// Instruction trace (see trace6502code in copro-65tubeasmM0.S, which has
+// the offsets of copro_65tube_trace_t)
+#define TRACE6502_RING 1024 // records, 16 bytes each
+
+// The 6502 state as an instruction is dispatched, with the flags as the
+// core keeps them (see copro_65tube_trace_p())
+typedef struct {
+   uint16_t pc;
+   uint8_t opcode;
+   uint8_t a, x, y, sp;
+   uint8_t vdi;           // V, D and I in nv-bdizc order
+   uint32_t nz;           // rflagsNZ: N if above 0xFF, Z if the low byte is zero
+   uint8_t systick[3];    // SysTick count down (TRACE6502_SYSTICK)
+   uint8_t c;             // carry in bit 0
+} copro_65tube_trace_record_t;
+
+typedef struct {
+   copro_65tube_trace_record_t *next; // NULL while stopped
+   copro_65tube_trace_record_t *end;
+   copro_65tube_trace_record_t *start;
+   uint32_t count;          // instructions recorded
+   uint32_t left;           // records still to take after the trigger, 0 before it
+   uint32_t trigger_pc;     // 0xFFFFFFFF for none
+   uint32_t trigger_count;  // instruction count, 0 for none
+   uint32_t trigger_events; // tube_irq bits (IRQ_BIT, NMI_BIT, RESET_BIT), 0 for none
+   uint32_t post;           // records to take after the trigger
+   uint32_t triggered;      // count at the trigger, 0 if it hasn't happened
+} copro_65tube_trace_t;
+
+extern copro_65tube_trace_t copro_65tube_trace;
+
+// Copro command 13 (see copro_command_excute())
+extern void copro_65tube_trace_command(uint8_t val);
+#endif
+
+#ifdef COPRO_SNAPSHOT
+#include "tube-ula.h"
+
+// Copro snapshots (see copro-65tube.c): a copro_65tube_snapshot_t, then the
+// 64KB of 6502 memory, all little endian. Bump the version when the layout
+// changes; header_size lets a reader find the memory after a longer header.
+#define COPRO_SNAPSHOT_MAGIC   0x50414E53 // "SNAP"
+#define COPRO_SNAPSHOT_VERSION 1
+
+// The 6502 registers a 65tube core stopped with at the last tube reset, and
+// with copro_65tube_resume set, starts with at the next one
+typedef struct {
+   uint32_t pc;
+   uint32_t a;
+   uint32_t x;
+   uint32_t y;
+   uint32_t sp;
+   uint32_t p;           // nv-bdizc, as PHP would push it without B
+} copro_65tube_regs_t;
+
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t header_size; // sizeof(copro_65tube_snapshot_t)
+   uint32_t copro;       // the copro that took it
+   uint32_t copro_speed;
+   uint32_t mem_sum;     // Fletcher checksum of the memory, see copro_65tube_snapshot_sum()
+   copro_65tube_regs_t regs;
+   tube_ula_snapshot_t ula;
+} copro_65tube_snapshot_t;
+
+static inline uint32_t copro_65tube_snapshot_sum(const uint8_t *mem, uint32_t len) {
+   uint32_t sum1 = 0, sum2 = 0;
+   while (len) {
+      // 256 bytes at a time can't overflow the sums
+      uint32_t n = len < 256 ? len : 256;
+      len -= n;
+      while (n--) {
+         sum1 += *mem++;
+         sum2 += sum1;
+      }
+      sum1 %= 65535;
+      sum2 %= 65535;
+   }
+   return (sum2 << 16) | sum1;
+}
+
+extern copro_65tube_regs_t copro_65tube_regs;
+
+extern int copro_65tube_resume;
+
+// What to do at the next tube reset (COPRO_SNAPSHOT_SAVE etc.)
+#define COPRO_SNAPSHOT_SAVE    1 // to flash
+#define COPRO_SNAPSHOT_RESTORE 2 // from flash
+#define COPRO_SNAPSHOT_STREAM  3 // over the UART
+#define COPRO_SNAPSHOT_SHOW    4 // stream the one in flash over the UART
+
+extern int copro_65tube_snapshot_pending;
+#endif
+
+extern void copro_65tubec_emulator();
+
 extern void exec_65tube(unsigned char *memory, unsigned int speed);
 
+// Portable C version of exec_65tube() (copro-65tubec.c)
+extern void exec_65tubec(unsigned char *memory, unsigned int speed);
+
+#ifdef BCD_TABLES
+// Builds the C core's decimal mode ADC and SBC tables (copro-65tubec.c)
+extern void bcd_tables_init(void);
+
+#ifdef PICO_TUBE_HOST
+// Returns the number of inputs the tables get wrong
+extern int bcd_tables_check(void);
+#endif
+#endif
+
+#ifdef TUBE_HLE
+// Set to run the Tube ROM's OSWRCH, OSBYTE and OSWORD natively (copro-65tubec.c)
+extern int copro_65tubec_hle;
+
+extern uint32_t copro_65tubec_hle_calls;
+#endif
+
 #endif
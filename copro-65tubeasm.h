@@ -1,3 +1,8 @@
 #define copro6502asm_instruction_table r9
 #define I_ALIGN_BITS 6
 #define copro6502asm_instruction_size  (1<<(8+I_ALIGN_BITS))
+
+// Uncomment to share one table between the event and slow handlers instead
+// of a table each (saves 32KB of RAM, and costs each event a jump). Not with
+// PROFILE6502.
+// #define COMPACT_DISPATCH
@@ -0,0 +1,1821 @@
+/*
+ * 65C02 Co Processor Emulation in portable C
+ *
+ * A reference for the Cortex M0 core in copro-65tubeasmM0.S, with the same
+ * exec_65tube() behaviour:
+ * - 65C02 instruction set including the Rockwell bit instructions, with the
+ *   undefined opcodes as NOPs of the same lengths
+ * - any 16 bit address in &FEF8-&FEFF goes to tube_parasite_read/write()
+ * - RESET, NMI and IRQ are taken from tube_irq between instructions, with
+ *   IRQ ignored while the I flag is set (so CLI, PLP and RTI see a pending
+ *   IRQ straight away)
+ * - with speed set, runs against copro_65tube_cycle_budget and calls
+ *   copro_65tube_throttle() when it runs out, as slowdown does
+ * - returns when RESET is seen
+ *
+ * Dispatch is by computed goto (a GCC extension, also in arm-none-eabi-gcc),
+ * with the event check and fetch repeated at the end of every opcode.
+ *
+ * This does not use the FAST6502 register flip, so it polls tube_irq
+ * instead. It builds for the host too, where host/copro-bench runs the
+ * Dormann test suites against it and reports instructions per second.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tube-defs.h"
+#include "tube.h"
+#include "tube-ula.h"
+#include "copro-65tube.h"
+#ifdef TUBE_HLE
+#include "tuberom_6502.h"
+#endif
+
+#define P_N 0x80
+#define P_V 0x40
+#define P_X 0x20
+#define P_B 0x10
+#define P_D 0x08
+#define P_I 0x04
+#define P_Z 0x02
+#define P_C 0x01
+
+// tube_irq bits that interrupt the 6502, depending on the I flag
+#define EVENTS_IRQ    (RESET_BIT | NMI_BIT | IRQ_BIT)
+#define EVENTS_NO_IRQ (RESET_BIT | NMI_BIT)
+
+#ifdef PICO_TUBE_HOST
+uint64_t copro_65tubec_instructions;
+#define COUNT_INSTRUCTION() copro_65tubec_instructions++
+#else
+#define COUNT_INSTRUCTION()
+#endif
+
+// 6502 cycles per opcode, as in the assembler core's timing_table
+static const uint8_t cycles_6502[256] = {
+   7, 6, 2, 1, 5, 3, 5, 5, 3, 2, 2, 1, 6, 4, 6, 5,
+   2, 5, 5, 1, 5, 4, 6, 5, 2, 4, 2, 1, 6, 4, 7, 5,
+   5, 6, 2, 1, 3, 3, 5, 5, 4, 2, 2, 1, 4, 4, 6, 5,
+   2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 2, 1, 4, 4, 7, 5,
+   5, 6, 2, 1, 3, 3, 5, 5, 3, 2, 2, 1, 2, 4, 6, 5,
+   2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 3, 1, 8, 4, 7, 5,
+   5, 6, 2, 1, 3, 3, 5, 5, 4, 2, 2, 1, 5, 4, 6, 5,
+   2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 4, 1, 5, 4, 7, 5,
+   3, 6, 2, 1, 3, 3, 3, 5, 2, 2, 2, 1, 4, 4, 4, 5,
+   2, 6, 5, 1, 4, 4, 4, 5, 2, 5, 2, 1, 4, 5, 5, 5,
+   2, 6, 2, 1, 3, 3, 3, 5, 2, 2, 2, 1, 4, 4, 4, 5,
+   2, 5, 5, 1, 4, 4, 4, 5, 2, 4, 2, 1, 4, 4, 4, 5,
+   2, 6, 2, 1, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 5,
+   2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 3, 2, 4, 4, 7, 5,
+   2, 6, 2, 1, 3, 3, 5, 5, 2, 2, 2, 1, 4, 4, 6, 5,
+   2, 5, 5, 1, 4, 4, 6, 5, 2, 4, 4, 1, 4, 4, 7, 5
+};
+
+// The tube registers, as seen by the assembler core's IO checks
+#define IS_TUBE(addr) (((addr) & 0xFFF8) == 0xFEF8)
+
+#define READ(addr) (IS_TUBE(addr) ? tube_parasite_read(addr) : mem[addr])
+
+#define WRITE(addr, val)                       \
+   do {                                        \
+      if (IS_TUBE(addr)) {                     \
+         tube_parasite_write(addr, val);       \
+      } else {                                 \
+         mem[addr] = (val);                    \
+      }                                        \
+   } while (0)
+
+// Effective address (ea) for each addressing mode; the zero page modes wrap
+#define ZP  ea = mem[pc++]
+#define ZPX ea = (uint8_t)(mem[pc++] + x)
+#define ZPY ea = (uint8_t)(mem[pc++] + y)
+#define ABS ea = mem[pc] | (mem[(uint16_t)(pc + 1)] << 8); pc += 2
+#define ABX ABS; ea += x
+#define ABY ABS; ea += y
+#define IZX t = (uint8_t)(mem[pc++] + x); ea = mem[t] | (mem[(uint8_t)(t + 1)] << 8)
+#define IZY t = mem[pc++]; ea = (mem[t] | (mem[(uint8_t)(t + 1)] << 8)) + y
+#define IZP t = mem[pc++]; ea = mem[t] | (mem[(uint8_t)(t + 1)] << 8)
+
+#define PUSH(val) mem[0x100 + sp--] = (val)
+#define PULL()    mem[0x100 + ++sp]
+
+// N and Z are kept as the last result (nz): Z if the low byte is zero, N if
+// bit 7 or 8 is set (bit 8 lets BIT set N and Z together)
+#define GET_P() (((nz & 0x180) ? P_N : 0) | v | P_X | d | i | ((nz & 0xFF) ? 0 : P_Z) | c)
+
+#define SET_P(p)                                       \
+   do {                                                \
+      unsigned int p_ = (p);                           \
+      c = p_ & P_C;                                    \
+      nz = ((p_ & P_N) << 1) | !(p_ & P_Z);            \
+      v = p_ & P_V;                                    \
+      d = p_ & P_D;                                    \
+      i = p_ & P_I;                                    \
+      irq_mask = i ? EVENTS_NO_IRQ : EVENTS_IRQ;       \
+   } while (0)
+
+#ifdef COPRO_SNAPSHOT
+// Leave the registers in copro_65tube_regs when stopping for a tube reset,
+// and start from them instead of the reset vector with copro_65tube_resume
+#define SAVE_REGS()                                    \
+   do {                                                \
+      copro_65tube_regs.pc = pc;                       \
+      copro_65tube_regs.a = a;                         \
+      copro_65tube_regs.x = x;                         \
+      copro_65tube_regs.y = y;                         \
+      copro_65tube_regs.sp = sp;                       \
+      copro_65tube_regs.p = GET_P();                   \
+   } while (0)
+
+#define RESUME_REGS()                                  \
+   do {                                                \
+      if (copro_65tube_resume) {                       \
+         pc = copro_65tube_regs.pc;                    \
+         a = copro_65tube_regs.a;                      \
+         x = copro_65tube_regs.x;                      \
+         y = copro_65tube_regs.y;                      \
+         sp = copro_65tube_regs.sp;                    \
+         SET_P(copro_65tube_regs.p);                   \
+      }                                                \
+   } while (0)
+#else
+#define SAVE_REGS()
+#define RESUME_REGS()
+#endif
+
+#define INTERRUPT(vector, bflag)                       \
+   do {                                                \
+      PUSH(pc >> 8);                                   \
+      PUSH(pc);                                        \
+      PUSH(GET_P() | (bflag));                         \
+      i = P_I;                                         \
+      d = 0;                                           \
+      irq_mask = EVENTS_NO_IRQ;                        \
+      pc = mem[vector] | (mem[vector + 1] << 8);       \
+   } while (0)
+
+#define ADC(val)                                       \
+   do {                                                \
+      unsigned int m_ = (val);                         \
+      if (d) {                                         \
+         a = ADC_DECIMAL(a, m_, &c, &v);               \
+      } else {                                         \
+         unsigned int s_ = a + m_ + c;                 \
+         v = (~(a ^ m_) & (a ^ s_) & 0x80) ? P_V : 0;  \
+         c = s_ >> 8;                                  \
+         a = (uint8_t) s_;                             \
+      }                                                \
+      nz = a;                                          \
+   } while (0)
+
+#define SBC(val)                                       \
+   do {                                                \
+      unsigned int m_ = (val);                         \
+      if (d) {                                         \
+         a = SBC_DECIMAL(a, m_, &c, &v);               \
+      } else {                                         \
+         unsigned int s_ = a + (m_ ^ 0xFF) + c;        \
+         v = ((a ^ m_) & (a ^ s_) & 0x80) ? P_V : 0;   \
+         c = s_ >> 8;                                  \
+         a = (uint8_t) s_;                             \
+      }                                                \
+      nz = a;                                          \
+   } while (0)
+
+#define COMPARE(reg, val)                              \
+   do {                                                \
+      unsigned int m_ = (val);                         \
+      c = (reg) >= m_;                                 \
+      nz = (uint8_t)((reg) - m_);                      \
+   } while (0)
+
+#define BIT(val)                                       \
+   do {                                                \
+      unsigned int m_ = (val);                         \
+      nz = (a & m_) | ((m_ & 0x80) << 1);              \
+      v = m_ & P_V;                                    \
+   } while (0)
+
+// TSB, TRB and BIT # only change Z
+#define TEST_BITS(val) nz = ((a & (val)) ? 1 : 0) | ((nz & 0x180) ? 0x100 : 0)
+
+#define BRANCH(cond)                                   \
+   do {                                                \
+      int8_t offset_ = mem[pc++];                      \
+      if (cond) {                                      \
+         pc += offset_;                                \
+      }                                                \
+   } while (0)
+
+#define OP(n) op_##n:
+
+#define NEXT                                           \
+   do {                                                \
+      COUNT_INSTRUCTION();                             \
+      if ((tube_irq & irq_mask) || cycles >= cycle_limit) { \
+         goto event;                                   \
+      }                                                \
+      opcode = mem[pc++];                              \
+      cycles += cycles_6502[opcode];                   \
+      goto *dispatch[opcode];                          \
+   } while (0)
+
+// 65C02 decimal mode: N and Z come from the decimal result, V as the 6502
+static uint8_t adc_decimal(unsigned int a, unsigned int m, unsigned int *c, unsigned int *v)
+{
+   unsigned int lo = (a & 0x0F) + (m & 0x0F) + *c;
+   if (lo > 0x09) {
+      lo += 0x06;
+   }
+   unsigned int hi = (a >> 4) + (m >> 4) + (lo > 0x0F);
+   *v = (~(a ^ m) & (a ^ (hi << 4)) & 0x80) ? P_V : 0;
+   if (hi > 0x09) {
+      hi += 0x06;
+   }
+   *c = hi > 0x0F;
+   return (hi << 4) | (lo & 0x0F);
+}
+
+static uint8_t sbc_decimal(unsigned int a, unsigned int m, unsigned int *c, unsigned int *v)
+{
+   int borrow = !*c;
+   int lo = (a & 0x0F) - (m & 0x0F) - borrow;
+   int result = a - m - borrow;
+   *v = ((a ^ m) & (a ^ result) & 0x80) ? P_V : 0;
+   *c = result >= 0;
+   if (result < 0) {
+      result -= 0x60;
+   }
+   if (lo < 0) {
+      result -= 0x06;
+   }
+   return result;
+}
+
+#ifdef BCD_TABLES
+
+// Decimal mode by table lookup
+//
+// The low nibbles and carry in index a lo table (c << 8 | a << 4 | m, of the
+// low nibbles) for the low digit, and in bits 4-5, what carries into the high
+// nibbles. That and the high nibbles index a hi table (carry << 8 | a << 4 |
+// m, of the high nibbles) for the high digit, V in bit 1 and C in bit 0. An
+// SBC of invalid BCD can borrow two from the high nibbles, so bcd_sbc_hi has
+// three kinds of carry in.
+//
+// The tables are built from adc_decimal() and sbc_decimal(), so give the
+// same results for every input, valid BCD or not.
+static uint8_t bcd_adc_lo[512];
+static uint8_t bcd_adc_hi[512];
+static uint8_t bcd_sbc_lo[512];
+static uint8_t bcd_sbc_hi[1024];
+
+void bcd_tables_init(void)
+{
+   // The low nibbles and carry in that give each kind of carry
+   static const uint8_t adc_carry[2][3] = { { 0x0, 0x0, 0 }, { 0x9, 0x1, 0 } };
+   static const uint8_t sbc_carry[3][3] = { { 0x0, 0x0, 1 }, { 0x0, 0x1, 1 }, { 0x0, 0xF, 0 } };
+   unsigned int a, m, k, c, v, r;
+
+   for (a = 0; a < 16; a++) {
+      for (m = 0; m < 16; m++) {
+         for (k = 0; k < 2; k++) {
+            // With no high nibbles, the high digit of the result is the carry
+            c = k;
+            bcd_adc_lo[(k << 8) | (a << 4) | m] = adc_decimal(a, m, &c, &v);
+            c = k;
+            r = sbc_decimal(a, m, &c, &v);
+            bcd_sbc_lo[(k << 8) | (a << 4) | m] = (r & 0x0F) | ((r & 0xF0) == 0x00 ? 0x00 : (r & 0xF0) == 0x90 ? 0x10 : 0x20);
+
+            c = adc_carry[k][2];
+            r = adc_decimal((a << 4) | adc_carry[k][0], (m << 4) | adc_carry[k][1], &c, &v);
+            bcd_adc_hi[(k << 8) | (a << 4) | m] = (r & 0xF0) | (v ? 2 : 0) | c;
+         }
+         for (k = 0; k < 3; k++) {
+            c = sbc_carry[k][2];
+            r = sbc_decimal((a << 4) | sbc_carry[k][0], (m << 4) | sbc_carry[k][1], &c, &v);
+            bcd_sbc_hi[(k << 8) | (a << 4) | m] = (r & 0xF0) | (v ? 2 : 0) | c;
+         }
+      }
+   }
+}
+
+static inline uint8_t bcd_lookup(const uint8_t *lo_table, const uint8_t *hi_table, unsigned int a, unsigned int m, unsigned int *c, unsigned int *v)
+{
+   unsigned int lo = lo_table[(*c << 8) | ((a & 0x0F) << 4) | (m & 0x0F)];
+   unsigned int hi = hi_table[((lo & 0x30) << 4) | (a & 0xF0) | (m >> 4)];
+   *c = hi & 1;
+   *v = (hi & 2) ? P_V : 0;
+   return (hi & 0xF0) | (lo & 0x0F);
+}
+
+#define ADC_DECIMAL(a, m, c, v) bcd_lookup(bcd_adc_lo, bcd_adc_hi, a, m, c, v)
+#define SBC_DECIMAL(a, m, c, v) bcd_lookup(bcd_sbc_lo, bcd_sbc_hi, a, m, c, v)
+
+#ifdef PICO_TUBE_HOST
+// Check the tables against adc_decimal() and sbc_decimal() for every input
+int bcd_tables_check(void)
+{
+   unsigned int a, m, c, c1, v1, c2, v2, r1, r2;
+   int errors = 0;
+
+   for (a = 0; a < 256; a++) {
+      for (m = 0; m < 256; m++) {
+         for (c = 0; c < 2; c++) {
+            c1 = c2 = c;
+            r1 = adc_decimal(a, m, &c1, &v1);
+            r2 = ADC_DECIMAL(a, m, &c2, &v2);
+            errors += r1 != r2 || c1 != c2 || v1 != v2;
+            c1 = c2 = c;
+            r1 = sbc_decimal(a, m, &c1, &v1);
+            r2 = SBC_DECIMAL(a, m, &c2, &v2);
+            errors += r1 != r2 || c1 != c2 || v1 != v2;
+         }
+      }
+   }
+   return errors;
+}
+#endif
+
+#else
+
+#define ADC_DECIMAL adc_decimal
+#define SBC_DECIMAL sbc_decimal
+
+#endif
+
+#ifdef TUBE_HLE
+
+// Native Tube ROM OSWRCH, OSBYTE and OSWORD
+//
+// With the stock Tube ROM installed, a JMP (&020E), (&020C) or (&020A) that
+// lands on the ROM's own OSWRCH, OSWORD or OSBYTE code runs that code here
+// instead. Each step does to the registers, flags, memory and tube registers
+// what the ROM's instructions would, so the 6502 sees the same results, with
+// none of the fetch and dispatch.
+//
+// The ROM waits for the host in BIT status/BVC (or BPL) loops. Where the
+// host isn't ready, or an interrupt is due, this stops at the top of that
+// loop with the state the ROM would have there, and the 6502 carries on in
+// the ROM. OSBYTE &8E (start a language) and OSWORD 0 (read a line) are left
+// to the ROM, as is all of it when the 6502 is throttled, so that it keeps
+// to its cycle count.
+
+#define HLE_WRCH 0xF962
+#define HLE_BYTE 0xFA73
+#define HLE_WORD 0xFAFF
+
+int copro_65tubec_hle = 1;
+uint32_t copro_65tubec_hle_calls;
+
+typedef struct {
+   uint8_t a, x, y, sp, p;
+   uint16_t pc;
+} hle_regs_t;
+
+// Whether the ROM code from start to end is the stock ROM's
+static int hle_rom(const uint8_t *mem, unsigned int start, unsigned int end)
+{
+   return !memcmp(mem + start, tuberom_6502_extern_1_10 + start - 0xF800, end - start);
+}
+
+static inline uint8_t hle_read(const uint8_t *mem, uint16_t addr)
+{
+   return IS_TUBE(addr) ? tube_parasite_read(addr) : mem[addr];
+}
+
+static inline void hle_write(uint8_t *mem, uint16_t addr, uint8_t val)
+{
+   if (IS_TUBE(addr)) {
+      tube_parasite_write(addr, val);
+   } else {
+      mem[addr] = val;
+   }
+}
+
+// (&F8),Y
+static inline uint16_t hle_ind_y(const uint8_t *mem, const hle_regs_t *r)
+{
+   return (mem[0xF8] | (mem[0xF9] << 8)) + r->y;
+}
+
+static inline void hle_nz(hle_regs_t *r, uint8_t val)
+{
+   r->p = (r->p & ~(P_N | P_Z)) | (val & P_N) | (val ? 0 : P_Z);
+}
+
+static inline void hle_compare(hle_regs_t *r, uint8_t reg, uint8_t m)
+{
+   hle_nz(r, reg - m);
+   r->p = (r->p & ~P_C) | (reg >= m ? P_C : 0);
+}
+
+static inline uint8_t hle_bit(hle_regs_t *r, uint16_t addr)
+{
+   uint8_t m = tube_parasite_read(addr);
+   r->p = (r->p & ~(P_N | P_V | P_Z)) | (m & (P_N | P_V)) | ((r->a & m) ? 0 : P_Z);
+   return m;
+}
+
+static inline void hle_push(uint8_t *mem, hle_regs_t *r, uint8_t val)
+{
+   hle_write(mem, 0x100 + r->sp--, val);
+}
+
+static inline uint8_t hle_pull(const uint8_t *mem, hle_regs_t *r)
+{
+   return mem[0x100 + ++r->sp];
+}
+
+static inline void hle_rts(const uint8_t *mem, hle_regs_t *r)
+{
+   unsigned int t = hle_pull(mem, r);
+   r->pc = (t | (hle_pull(mem, r) << 8)) + 1;
+}
+
+// The ROM's BIT status: BVC/BPL loop at loop, left to the ROM if an
+// interrupt is due or the status doesn't have ready set
+#define HLE_WAIT(status, ready, loop)                                   \
+   do {                                                                 \
+      unsigned int events_ = (r->p & P_I) ? EVENTS_NO_IRQ : EVENTS_IRQ; \
+      if ((tube_irq & events_) || !(hle_bit(r, status) & (ready))) {   \
+         r->pc = (loop);                                                \
+         return;                                                        \
+      }                                                                 \
+   } while (0)
+
+// &F962: the byte in A on R1
+static void hle_oswrch(uint8_t *mem, hle_regs_t *r)
+{
+   HLE_WAIT(0xFEF8, 0x40, 0xF962);
+   tube_parasite_write(0xFEF9, r->a);
+   hle_rts(mem, r);
+}
+
+// &FA73
+static void hle_osbyte(uint8_t *mem, hle_regs_t *r)
+{
+   uint8_t m;
+
+   hle_compare(r, r->a, 0x80);
+   if (r->a < 0x80) {
+      // 4, X, A on R2, then X back
+      hle_push(mem, r, r->a);
+      r->a = 0x04;
+      hle_nz(r, r->a);
+      HLE_WAIT(0xFEFA, 0x40, 0xFA7A);
+      tube_parasite_write(0xFEFB, r->a);
+      HLE_WAIT(0xFEFA, 0x40, 0xFA82);
+      tube_parasite_write(0xFEFB, r->x);
+      r->a = hle_pull(mem, r);
+      hle_nz(r, r->a);
+      HLE_WAIT(0xFEFA, 0x40, 0xFA8B);
+      tube_parasite_write(0xFEFB, r->a);
+      HLE_WAIT(0xFEFA, 0x80, 0xFA93);
+      r->x = tube_parasite_read(0xFEFB);
+      hle_nz(r, r->x);
+      hle_rts(mem, r);
+      return;
+   }
+   // &82-&84 are answered by the ROM itself
+   hle_compare(r, r->a, 0x82);
+   if (r->a == 0x82) {
+      r->x = 0x00;
+      r->y = 0x00;
+      hle_nz(r, r->y);
+      hle_rts(mem, r);
+      return;
+   }
+   hle_compare(r, r->a, 0x83);
+   if (r->a == 0x83) {
+      r->x = 0x00;
+      r->y = 0x08;
+      hle_nz(r, r->y);
+      hle_rts(mem, r);
+      return;
+   }
+   hle_compare(r, r->a, 0x84);
+   if (r->a == 0x84) {
+      r->x = mem[0xF2];
+      r->y = mem[0xF3];
+      hle_nz(r, r->y);
+      hle_rts(mem, r);
+      return;
+   }
+   // 6, X, Y, A on R2, then C, Y, X back (but not for &9D)
+   hle_push(mem, r, r->a);
+   r->a = 0x06;
+   hle_nz(r, r->a);
+   HLE_WAIT(0xFEFA, 0x40, 0xFAAB);
+   tube_parasite_write(0xFEFB, r->a);
+   HLE_WAIT(0xFEFA, 0x40, 0xFAB3);
+   tube_parasite_write(0xFEFB, r->x);
+   HLE_WAIT(0xFEFA, 0x40, 0xFABB);
+   tube_parasite_write(0xFEFB, r->y);
+   r->a = hle_pull(mem, r);
+   hle_nz(r, r->a);
+   HLE_WAIT(0xFEFA, 0x40, 0xFAC4);
+   tube_parasite_write(0xFEFB, r->a);
+   hle_compare(r, r->a, 0x8E);
+   hle_compare(r, r->a, 0x9D);
+   if (r->a == 0x9D) {
+      hle_rts(mem, r);
+      return;
+   }
+   hle_push(mem, r, r->a);
+   HLE_WAIT(0xFEFA, 0x80, 0xFAD5);
+   m = tube_parasite_read(0xFEFB);
+   r->a = m << 1;
+   r->p = (r->p & ~P_C) | (m >> 7);
+   hle_nz(r, r->a);
+   r->a = hle_pull(mem, r);
+   hle_nz(r, r->a);
+   HLE_WAIT(0xFEFA, 0x80, 0xFADF);
+   r->y = tube_parasite_read(0xFEFB);
+   hle_nz(r, r->y);
+   HLE_WAIT(0xFEFA, 0x80, 0xFAE7);
+   r->x = tube_parasite_read(0xFEFB);
+   hle_nz(r, r->x);
+   hle_rts(mem, r);
+}
+
+// &FAFF: 8, A on R2, then the control block at YX out and back, with the
+// lengths in its first two bytes for A >= &80, or from the ROM's tables
+static void hle_osword(uint8_t *mem, hle_regs_t *r)
+{
+   hle_write(mem, 0xF8, r->x);
+   hle_write(mem, 0xF9, r->y);
+   r->y = r->a;
+   hle_nz(r, r->y);
+   hle_push(mem, r, r->a);
+   r->y = 0x08;
+   hle_nz(r, r->y);
+   HLE_WAIT(0xFEFA, 0x40, 0xFB09);
+   tube_parasite_write(0xFEFB, r->y);
+   HLE_WAIT(0xFEFA, 0x40, 0xFB11);
+   tube_parasite_write(0xFEFB, r->a);
+   r->x = r->a;
+   hle_nz(r, r->x);
+   if (r->x & 0x80) {
+      r->y = 0x00;
+      r->a = hle_read(mem, hle_ind_y(mem, r));
+      r->y = r->a;
+      hle_nz(r, r->y);
+   } else {
+      r->y = mem[0xFCBC + r->x];
+      hle_compare(r, r->x, 0x15);
+      if (r->x >= 0x15) {
+         r->y = 0x10;
+         hle_nz(r, r->y);
+      }
+   }
+   HLE_WAIT(0xFEFA, 0x40, 0xFB2D);
+   tube_parasite_write(0xFEFB, r->y);
+   r->y--;
+   hle_nz(r, r->y);
+   while (!(r->y & 0x80)) {
+      HLE_WAIT(0xFEFA, 0x40, 0xFB38);
+      r->a = hle_read(mem, hle_ind_y(mem, r));
+      hle_nz(r, r->a);
+      tube_parasite_write(0xFEFB, r->a);
+      r->y--;
+      hle_nz(r, r->y);
+   }
+   r->a = r->x;
+   hle_nz(r, r->a);
+   if (r->a & 0x80) {
+      r->y = 0x01;
+      r->a = hle_read(mem, hle_ind_y(mem, r));
+      r->y = r->a;
+      hle_nz(r, r->y);
+   } else {
+      r->y = mem[0xFCD0 + r->x];
+      hle_compare(r, r->x, 0x15);
+      if (r->x >= 0x15) {
+         r->y = 0x10;
+         hle_nz(r, r->y);
+      }
+   }
+   HLE_WAIT(0xFEFA, 0x40, 0xFB59);
+   tube_parasite_write(0xFEFB, r->y);
+   r->y--;
+   hle_nz(r, r->y);
+   while (!(r->y & 0x80)) {
+      HLE_WAIT(0xFEFA, 0x80, 0xFB64);
+      r->a = tube_parasite_read(0xFEFB);
+      hle_nz(r, r->a);
+      hle_write(mem, hle_ind_y(mem, r), r->a);
+      r->y--;
+      hle_nz(r, r->y);
+   }
+   r->y = mem[0xF9];
+   r->x = mem[0xF8];
+   r->a = hle_pull(mem, r);
+   hle_nz(r, r->a);
+   hle_rts(mem, r);
+}
+
+// Native language ROM routines (BASIC 2 and 4 floating point)
+//
+// A JSR into &8000-&BFFF looks its target up in the entries for the
+// language image there, if that is a known one. The image is recognised by
+// the CRC-32 of &8000-&BFFF (as ROM sets list it), taken at the first such
+// JSR after each reset. An entry does what the routine would, including its
+// RTS, or returns 0 to leave the call to the 6502.
+//
+// No image is listed yet. BASIC's 5-byte floating point has to match the
+// ROM bit for bit, rounding included, so an entry needs the image to check
+// against, with copro-bench running Sphere with and without it.
+
+typedef struct {
+   uint16_t addr;
+   int (*run)(uint8_t *mem, hle_regs_t *r);
+} hle_entry_t;
+
+typedef struct {
+   uint32_t crc;
+   const hle_entry_t *entries; // ends with addr 0
+} hle_image_t;
+
+static const hle_image_t hle_images[] = {
+   { 0, NULL }
+};
+
+static const hle_image_t *hle_image;
+static int hle_image_checked;
+
+static uint32_t hle_crc32(const uint8_t *mem, unsigned int len)
+{
+   uint32_t crc = 0xFFFFFFFF;
+   while (len--) {
+      crc ^= *mem++;
+      for (int b = 0; b < 8; b++) {
+         crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+      }
+   }
+   return ~crc;
+}
+
+static int __not_in_flash_func(hle_language)(uint8_t *mem, hle_regs_t *r)
+{
+   const hle_entry_t *e;
+   if (!hle_image_checked) {
+      hle_image_checked = 1;
+      hle_image = NULL;
+      if (hle_images[0].entries) {
+         uint32_t crc = hle_crc32(mem + 0x8000, 0x4000);
+         for (const hle_image_t *i = hle_images; i->entries; i++) {
+            if (i->crc == crc) {
+               hle_image = i;
+            }
+         }
+      }
+   }
+   if (!hle_image) {
+      return 0;
+   }
+   for (e = hle_image->entries; e->addr; e++) {
+      if (e->addr == r->pc) {
+         return e->run(mem, r);
+      }
+   }
+   return 0;
+}
+
+// Runs the ROM routine at r->pc, if it is one of the above, returning
+// whether it did
+static int __not_in_flash_func(tube_hle)(uint8_t *mem, hle_regs_t *r)
+{
+   switch (r->pc) {
+   case HLE_WRCH:
+      if (!hle_rom(mem, HLE_WRCH, 0xF96C)) {
+         return 0;
+      }
+      hle_oswrch(mem, r);
+      break;
+   case HLE_BYTE:
+      if (r->a == 0x8E || !hle_rom(mem, HLE_BYTE, 0xFAFF)) {
+         return 0;
+      }
+      hle_osbyte(mem, r);
+      break;
+   case HLE_WORD:
+      if (r->a == 0x00 || !hle_rom(mem, HLE_WORD, 0xFB77)) {
+         return 0;
+      }
+      hle_osword(mem, r);
+      break;
+   default:
+      if ((r->pc & 0xC000) != 0x8000 || !hle_language(mem, r)) {
+         return 0;
+      }
+      break;
+   }
+   copro_65tubec_hle_calls++;
+   return 1;
+}
+
+#define HLE_RUN()                                              \
+   do {                                                        \
+      hle_regs_t r_ = { a, x, y, sp, GET_P(), pc };            \
+      if (tube_hle(mem, &r_)) {                                \
+         a = r_.a;                                             \
+         x = r_.x;                                             \
+         y = r_.y;                                             \
+         sp = r_.sp;                                           \
+         SET_P(r_.p);                                          \
+         pc = r_.pc;                                           \
+      }                                                        \
+   } while (0)
+
+// After JMP (ind) through one of the MOS vectors at &0200-&020F
+#define HLE_VECTOR()                                           \
+   do {                                                        \
+      if (hle && (ea & 0xFFF0) == 0x0200) {                    \
+         HLE_RUN();                                            \
+      }                                                        \
+   } while (0)
+
+// After JSR into the language ROM image
+#define HLE_CALL()                                             \
+   do {                                                        \
+      if (hle && (pc & 0xC000) == 0x8000) {                    \
+         HLE_RUN();                                            \
+      }                                                        \
+   } while (0)
+
+#else
+
+#define HLE_VECTOR()
+#define HLE_CALL()
+
+#endif
+
+void __not_in_flash_func(exec_65tubec)(unsigned char *memory, unsigned int speed)
+{
+   static const void *const dispatch[256] = {
+      &&op_00, &&op_01, &&op_02, &&op_03, &&op_04, &&op_05, &&op_06, &&op_07, &&op_08, &&op_09, &&op_0A, &&op_0B, &&op_0C, &&op_0D, &&op_0E, &&op_0F,
+      &&op_10, &&op_11, &&op_12, &&op_13, &&op_14, &&op_15, &&op_16, &&op_17, &&op_18, &&op_19, &&op_1A, &&op_1B, &&op_1C, &&op_1D, &&op_1E, &&op_1F,
+      &&op_20, &&op_21, &&op_22, &&op_23, &&op_24, &&op_25, &&op_26, &&op_27, &&op_28, &&op_29, &&op_2A, &&op_2B, &&op_2C, &&op_2D, &&op_2E, &&op_2F,
+      &&op_30, &&op_31, &&op_32, &&op_33, &&op_34, &&op_35, &&op_36, &&op_37, &&op_38, &&op_39, &&op_3A, &&op_3B, &&op_3C, &&op_3D, &&op_3E, &&op_3F,
+      &&op_40, &&op_41, &&op_42, &&op_43, &&op_44, &&op_45, &&op_46, &&op_47, &&op_48, &&op_49, &&op_4A, &&op_4B, &&op_4C, &&op_4D, &&op_4E, &&op_4F,
+      &&op_50, &&op_51, &&op_52, &&op_53, &&op_54, &&op_55, &&op_56, &&op_57, &&op_58, &&op_59, &&op_5A, &&op_5B, &&op_5C, &&op_5D, &&op_5E, &&op_5F,
+      &&op_60, &&op_61, &&op_62, &&op_63, &&op_64, &&op_65, &&op_66, &&op_67, &&op_68, &&op_69, &&op_6A, &&op_6B, &&op_6C, &&op_6D, &&op_6E, &&op_6F,
+      &&op_70, &&op_71, &&op_72, &&op_73, &&op_74, &&op_75, &&op_76, &&op_77, &&op_78, &&op_79, &&op_7A, &&op_7B, &&op_7C, &&op_7D, &&op_7E, &&op_7F,
+      &&op_80, &&op_81, &&op_82, &&op_83, &&op_84, &&op_85, &&op_86, &&op_87, &&op_88, &&op_89, &&op_8A, &&op_8B, &&op_8C, &&op_8D, &&op_8E, &&op_8F,
+      &&op_90, &&op_91, &&op_92, &&op_93, &&op_94, &&op_95, &&op_96, &&op_97, &&op_98, &&op_99, &&op_9A, &&op_9B, &&op_9C, &&op_9D, &&op_9E, &&op_9F,
+      &&op_A0, &&op_A1, &&op_A2, &&op_A3, &&op_A4, &&op_A5, &&op_A6, &&op_A7, &&op_A8, &&op_A9, &&op_AA, &&op_AB, &&op_AC, &&op_AD, &&op_AE, &&op_AF,
+      &&op_B0, &&op_B1, &&op_B2, &&op_B3, &&op_B4, &&op_B5, &&op_B6, &&op_B7, &&op_B8, &&op_B9, &&op_BA, &&op_BB, &&op_BC, &&op_BD, &&op_BE, &&op_BF,
+      &&op_C0, &&op_C1, &&op_C2, &&op_C3, &&op_C4, &&op_C5, &&op_C6, &&op_C7, &&op_C8, &&op_C9, &&op_CA, &&op_CB, &&op_CC, &&op_CD, &&op_CE, &&op_CF,
+      &&op_D0, &&op_D1, &&op_D2, &&op_D3, &&op_D4, &&op_D5, &&op_D6, &&op_D7, &&op_D8, &&op_D9, &&op_DA, &&op_DB, &&op_DC, &&op_DD, &&op_DE, &&op_DF,
+      &&op_E0, &&op_E1, &&op_E2, &&op_E3, &&op_E4, &&op_E5, &&op_E6, &&op_E7, &&op_E8, &&op_E9, &&op_EA, &&op_EB, &&op_EC, &&op_ED, &&op_EE, &&op_EF,
+      &&op_F0, &&op_F1, &&op_F2, &&op_F3, &&op_F4, &&op_F5, &&op_F6, &&op_F7, &&op_F8, &&op_F9, &&op_FA, &&op_FB, &&op_FC, &&op_FD, &&op_FE, &&op_FF
+   };
+
+   uint8_t *mem = memory;
+   uint16_t pc, ea;
+   uint8_t a = 0, x = 0, y = 0, sp = 0xFE;
+   unsigned int nz = 0, c = 0, v = 0, d = 0, i = P_I;
+   unsigned int t, opcode;
+   unsigned int irq_mask = EVENTS_NO_IRQ;
+   uint32_t cycles = 0;
+   uint32_t cycle_limit = UINT32_MAX;
+#ifdef TUBE_HLE
+   int hle = copro_65tubec_hle && !speed;
+   // A reset may have brought in another language
+   hle_image_checked = 0;
+#endif
+
+   if (speed) {
+      cycle_limit = copro_65tube_cycle_budget > 0 ? copro_65tube_cycle_budget : 0;
+   }
+
+   pc = mem[0xFFFC] | (mem[0xFFFD] << 8);
+   RESUME_REGS();
+   NEXT;
+
+event:
+   if (cycles >= cycle_limit) {
+      if (speed) {
+         // Wait for the wall clock and take the next block of cycles
+         copro_65tube_cycle_budget -= cycles;
+         copro_65tube_throttle();
+         cycle_limit = copro_65tube_cycle_budget > 0 ? copro_65tube_cycle_budget : 0;
+      }
+      cycles = 0;
+   }
+   t = tube_irq & irq_mask;
+   if (t & RESET_BIT) {
+      SAVE_REGS();
+      if (speed) {
+         // Leave the budget as slowdown would, for copro_65tube_throttle_report()
+         copro_65tube_cycle_budget -= cycles;
+      }
+      return;
+   }
+   if (t & NMI_BIT) {
+      tube_ack_nmi();
+      INTERRUPT(0xFFFA, 0);
+   } else if (t & IRQ_BIT) {
+      INTERRUPT(0xFFFE, 0);
+   }
+   opcode = mem[pc++];
+   cycles += cycles_6502[opcode];
+   goto *dispatch[opcode];
+
+   OP(00) // BRK
+      pc++; INTERRUPT(0xFFFE, P_B);
+      NEXT;
+
+   OP(01) // ORA ($00,X)
+      IZX; a |= READ(ea); nz = a;
+      NEXT;
+
+   OP(02) // NOP
+      pc++;
+      NEXT;
+
+   OP(03) // NOP
+      NEXT;
+
+   OP(04) // TSB $00
+      ZP; t = mem[ea]; TEST_BITS(t); mem[ea] = t | a;
+      NEXT;
+
+   OP(05) // ORA $00
+      ZP; a |= mem[ea]; nz = a;
+      NEXT;
+
+   OP(06) // ASL $00
+      ZP; t = mem[ea]; c = t >> 7; t = (uint8_t)(t << 1); nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(07) // RMB0 $00
+      ZP; mem[ea] &= ~1;
+      NEXT;
+
+   OP(08) // PHP
+      PUSH(GET_P() | P_B);
+      NEXT;
+
+   OP(09) // ORA #$00
+      a |= mem[pc++]; nz = a;
+      NEXT;
+
+   OP(0A) // ASL A
+      t = a; c = t >> 7; t = (uint8_t)(t << 1); a = t; nz = a;
+      NEXT;
+
+   OP(0B) // NOP
+      NEXT;
+
+   OP(0C) // TSB $0000
+      ABS; t = READ(ea); TEST_BITS(t); WRITE(ea, t | a);
+      NEXT;
+
+   OP(0D) // ORA $0000
+      ABS; a |= READ(ea); nz = a;
+      NEXT;
+
+   OP(0E) // ASL $0000
+      ABS; t = READ(ea); c = t >> 7; t = (uint8_t)(t << 1); nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(0F) // BBR0 $00
+      ZP; t = mem[ea]; BRANCH(!(t & 1));
+      NEXT;
+
+   OP(10) // BPL
+      BRANCH(!(nz & 0x180));
+      NEXT;
+
+   OP(11) // ORA ($00),Y
+      IZY; a |= READ(ea); nz = a;
+      NEXT;
+
+   OP(12) // ORA ($00)
+      IZP; a |= READ(ea); nz = a;
+      NEXT;
+
+   OP(13) // NOP
+      NEXT;
+
+   OP(14) // TRB $00
+      ZP; t = mem[ea]; TEST_BITS(t); mem[ea] = t & ~a;
+      NEXT;
+
+   OP(15) // ORA $00,X
+      ZPX; a |= mem[ea]; nz = a;
+      NEXT;
+
+   OP(16) // ASL $00,X
+      ZPX; t = mem[ea]; c = t >> 7; t = (uint8_t)(t << 1); nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(17) // RMB1 $00
+      ZP; mem[ea] &= ~2;
+      NEXT;
+
+   OP(18) // CLC
+      c = 0;
+      NEXT;
+
+   OP(19) // ORA $0000,Y
+      ABY; a |= READ(ea); nz = a;
+      NEXT;
+
+   OP(1A) // INC A
+      a++; nz = a;
+      NEXT;
+
+   OP(1B) // NOP
+      NEXT;
+
+   OP(1C) // TRB $0000
+      ABS; t = READ(ea); TEST_BITS(t); WRITE(ea, t & ~a);
+      NEXT;
+
+   OP(1D) // ORA $0000,X
+      ABX; a |= READ(ea); nz = a;
+      NEXT;
+
+   OP(1E) // ASL $0000,X
+      ABX; t = READ(ea); c = t >> 7; t = (uint8_t)(t << 1); nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(1F) // BBR1 $00
+      ZP; t = mem[ea]; BRANCH(!(t & 2));
+      NEXT;
+
+   OP(20) // JSR $0000
+      ABS; pc--; PUSH(pc >> 8); PUSH(pc); pc = ea;
+      HLE_CALL();
+      NEXT;
+
+   OP(21) // AND ($00,X)
+      IZX; a &= READ(ea); nz = a;
+      NEXT;
+
+   OP(22) // NOP
+      pc++;
+      NEXT;
+
+   OP(23) // NOP
+      NEXT;
+
+   OP(24) // BIT $00
+      ZP; BIT(mem[ea]);
+      NEXT;
+
+   OP(25) // AND $00
+      ZP; a &= mem[ea]; nz = a;
+      NEXT;
+
+   OP(26) // ROL $00
+      ZP; t = mem[ea]; t = (t << 1) | c; c = t >> 8; t = (uint8_t) t; nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(27) // RMB2 $00
+      ZP; mem[ea] &= ~4;
+      NEXT;
+
+   OP(28) // PLP
+      SET_P(PULL());
+      NEXT;
+
+   OP(29) // AND #$00
+      a &= mem[pc++]; nz = a;
+      NEXT;
+
+   OP(2A) // ROL A
+      t = a; t = (t << 1) | c; c = t >> 8; t = (uint8_t) t; a = t; nz = a;
+      NEXT;
+
+   OP(2B) // NOP
+      NEXT;
+
+   OP(2C) // BIT $0000
+      ABS; BIT(READ(ea));
+      NEXT;
+
+   OP(2D) // AND $0000
+      ABS; a &= READ(ea); nz = a;
+      NEXT;
+
+   OP(2E) // ROL $0000
+      ABS; t = READ(ea); t = (t << 1) | c; c = t >> 8; t = (uint8_t) t; nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(2F) // BBR2 $00
+      ZP; t = mem[ea]; BRANCH(!(t & 4));
+      NEXT;
+
+   OP(30) // BMI
+      BRANCH(nz & 0x180);
+      NEXT;
+
+   OP(31) // AND ($00),Y
+      IZY; a &= READ(ea); nz = a;
+      NEXT;
+
+   OP(32) // AND ($00)
+      IZP; a &= READ(ea); nz = a;
+      NEXT;
+
+   OP(33) // NOP
+      NEXT;
+
+   OP(34) // BIT $00,X
+      ZPX; BIT(mem[ea]);
+      NEXT;
+
+   OP(35) // AND $00,X
+      ZPX; a &= mem[ea]; nz = a;
+      NEXT;
+
+   OP(36) // ROL $00,X
+      ZPX; t = mem[ea]; t = (t << 1) | c; c = t >> 8; t = (uint8_t) t; nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(37) // RMB3 $00
+      ZP; mem[ea] &= ~8;
+      NEXT;
+
+   OP(38) // SEC
+      c = 1;
+      NEXT;
+
+   OP(39) // AND $0000,Y
+      ABY; a &= READ(ea); nz = a;
+      NEXT;
+
+   OP(3A) // DEC A
+      a--; nz = a;
+      NEXT;
+
+   OP(3B) // NOP
+      NEXT;
+
+   OP(3C) // BIT $0000,X
+      ABX; BIT(READ(ea));
+      NEXT;
+
+   OP(3D) // AND $0000,X
+      ABX; a &= READ(ea); nz = a;
+      NEXT;
+
+   OP(3E) // ROL $0000,X
+      ABX; t = READ(ea); t = (t << 1) | c; c = t >> 8; t = (uint8_t) t; nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(3F) // BBR3 $00
+      ZP; t = mem[ea]; BRANCH(!(t & 8));
+      NEXT;
+
+   OP(40) // RTI
+      SET_P(PULL()); t = PULL(); pc = t | (PULL() << 8);
+      NEXT;
+
+   OP(41) // EOR ($00,X)
+      IZX; a ^= READ(ea); nz = a;
+      NEXT;
+
+   OP(42) // NOP
+      pc++;
+      NEXT;
+
+   OP(43) // NOP
+      NEXT;
+
+   OP(44) // NOP
+      pc++;
+      NEXT;
+
+   OP(45) // EOR $00
+      ZP; a ^= mem[ea]; nz = a;
+      NEXT;
+
+   OP(46) // LSR $00
+      ZP; t = mem[ea]; c = t & 1; t >>= 1; nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(47) // RMB4 $00
+      ZP; mem[ea] &= ~16;
+      NEXT;
+
+   OP(48) // PHA
+      PUSH(a);
+      NEXT;
+
+   OP(49) // EOR #$00
+      a ^= mem[pc++]; nz = a;
+      NEXT;
+
+   OP(4A) // LSR A
+      t = a; c = t & 1; t >>= 1; a = t; nz = a;
+      NEXT;
+
+   OP(4B) // NOP
+      NEXT;
+
+   OP(4C) // JMP $0000
+      ABS; pc = ea;
+      NEXT;
+
+   OP(4D) // EOR $0000
+      ABS; a ^= READ(ea); nz = a;
+      NEXT;
+
+   OP(4E) // LSR $0000
+      ABS; t = READ(ea); c = t & 1; t >>= 1; nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(4F) // BBR4 $00
+      ZP; t = mem[ea]; BRANCH(!(t & 16));
+      NEXT;
+
+   OP(50) // BVC
+      BRANCH(!v);
+      NEXT;
+
+   OP(51) // EOR ($00),Y
+      IZY; a ^= READ(ea); nz = a;
+      NEXT;
+
+   OP(52) // EOR ($00)
+      IZP; a ^= READ(ea); nz = a;
+      NEXT;
+
+   OP(53) // NOP
+      NEXT;
+
+   OP(54) // NOP
+      pc++;
+      NEXT;
+
+   OP(55) // EOR $00,X
+      ZPX; a ^= mem[ea]; nz = a;
+      NEXT;
+
+   OP(56) // LSR $00,X
+      ZPX; t = mem[ea]; c = t & 1; t >>= 1; nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(57) // RMB5 $00
+      ZP; mem[ea] &= ~32;
+      NEXT;
+
+   OP(58) // CLI
+      i = 0; irq_mask = EVENTS_IRQ;
+      NEXT;
+
+   OP(59) // EOR $0000,Y
+      ABY; a ^= READ(ea); nz = a;
+      NEXT;
+
+   OP(5A) // PHY
+      PUSH(y);
+      NEXT;
+
+   OP(5B) // NOP
+      NEXT;
+
+   OP(5C) // NOP
+      pc += 2;
+      NEXT;
+
+   OP(5D) // EOR $0000,X
+      ABX; a ^= READ(ea); nz = a;
+      NEXT;
+
+   OP(5E) // LSR $0000,X
+      ABX; t = READ(ea); c = t & 1; t >>= 1; nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(5F) // BBR5 $00
+      ZP; t = mem[ea]; BRANCH(!(t & 32));
+      NEXT;
+
+   OP(60) // RTS
+      t = PULL(); pc = (t | (PULL() << 8)) + 1;
+      NEXT;
+
+   OP(61) // ADC ($00,X)
+      IZX; ADC(READ(ea));
+      NEXT;
+
+   OP(62) // NOP
+      pc++;
+      NEXT;
+
+   OP(63) // NOP
+      NEXT;
+
+   OP(64) // STZ $00
+      ZP; mem[ea] = 0;
+      NEXT;
+
+   OP(65) // ADC $00
+      ZP; ADC(mem[ea]);
+      NEXT;
+
+   OP(66) // ROR $00
+      ZP; t = mem[ea]; t |= c << 8; c = t & 1; t >>= 1; nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(67) // RMB6 $00
+      ZP; mem[ea] &= ~64;
+      NEXT;
+
+   OP(68) // PLA
+      a = PULL(); nz = a;
+      NEXT;
+
+   OP(69) // ADC #$00
+      ADC(mem[pc++]);
+      NEXT;
+
+   OP(6A) // ROR A
+      t = a; t |= c << 8; c = t & 1; t >>= 1; a = t; nz = a;
+      NEXT;
+
+   OP(6B) // NOP
+      NEXT;
+
+   OP(6C) // JMP ($0000)
+      ABS; pc = mem[ea] | (mem[(uint16_t)(ea + 1)] << 8);
+      HLE_VECTOR();
+      NEXT;
+
+   OP(6D) // ADC $0000
+      ABS; ADC(READ(ea));
+      NEXT;
+
+   OP(6E) // ROR $0000
+      ABS; t = READ(ea); t |= c << 8; c = t & 1; t >>= 1; nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(6F) // BBR6 $00
+      ZP; t = mem[ea]; BRANCH(!(t & 64));
+      NEXT;
+
+   OP(70) // BVS
+      BRANCH(v);
+      NEXT;
+
+   OP(71) // ADC ($00),Y
+      IZY; ADC(READ(ea));
+      NEXT;
+
+   OP(72) // ADC ($00)
+      IZP; ADC(READ(ea));
+      NEXT;
+
+   OP(73) // NOP
+      NEXT;
+
+   OP(74) // STZ $00,X
+      ZPX; mem[ea] = 0;
+      NEXT;
+
+   OP(75) // ADC $00,X
+      ZPX; ADC(mem[ea]);
+      NEXT;
+
+   OP(76) // ROR $00,X
+      ZPX; t = mem[ea]; t |= c << 8; c = t & 1; t >>= 1; nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(77) // RMB7 $00
+      ZP; mem[ea] &= ~128;
+      NEXT;
+
+   OP(78) // SEI
+      i = P_I; irq_mask = EVENTS_NO_IRQ;
+      NEXT;
+
+   OP(79) // ADC $0000,Y
+      ABY; ADC(READ(ea));
+      NEXT;
+
+   OP(7A) // PLY
+      y = PULL(); nz = y;
+      NEXT;
+
+   OP(7B) // NOP
+      NEXT;
+
+   OP(7C) // JMP ($0000,X)
+      ABX; pc = mem[ea] | (mem[(uint16_t)(ea + 1)] << 8);
+      NEXT;
+
+   OP(7D) // ADC $0000,X
+      ABX; ADC(READ(ea));
+      NEXT;
+
+   OP(7E) // ROR $0000,X
+      ABX; t = READ(ea); t |= c << 8; c = t & 1; t >>= 1; nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(7F) // BBR7 $00
+      ZP; t = mem[ea]; BRANCH(!(t & 128));
+      NEXT;
+
+   OP(80) // BRA
+      BRANCH(1);
+      NEXT;
+
+   OP(81) // STA ($00,X)
+      IZX; WRITE(ea, a);
+      NEXT;
+
+   OP(82) // NOP
+      pc++;
+      NEXT;
+
+   OP(83) // NOP
+      NEXT;
+
+   OP(84) // STY $00
+      ZP; mem[ea] = y;
+      NEXT;
+
+   OP(85) // STA $00
+      ZP; mem[ea] = a;
+      NEXT;
+
+   OP(86) // STX $00
+      ZP; mem[ea] = x;
+      NEXT;
+
+   OP(87) // SMB0 $00
+      ZP; mem[ea] |= 1;
+      NEXT;
+
+   OP(88) // DEY
+      y--; nz = y;
+      NEXT;
+
+   OP(89) // BIT #$00 (only changes Z)
+      TEST_BITS(mem[pc++]);
+      NEXT;
+
+   OP(8A) // TXA
+      a = x; nz = a;
+      NEXT;
+
+   OP(8B) // NOP
+      NEXT;
+
+   OP(8C) // STY $0000
+      ABS; WRITE(ea, y);
+      NEXT;
+
+   OP(8D) // STA $0000
+      ABS; WRITE(ea, a);
+      NEXT;
+
+   OP(8E) // STX $0000
+      ABS; WRITE(ea, x);
+      NEXT;
+
+   OP(8F) // BBS0 $00
+      ZP; t = mem[ea]; BRANCH(t & 1);
+      NEXT;
+
+   OP(90) // BCC
+      BRANCH(!c);
+      NEXT;
+
+   OP(91) // STA ($00),Y
+      IZY; WRITE(ea, a);
+      NEXT;
+
+   OP(92) // STA ($00)
+      IZP; WRITE(ea, a);
+      NEXT;
+
+   OP(93) // NOP
+      NEXT;
+
+   OP(94) // STY $00,X
+      ZPX; mem[ea] = y;
+      NEXT;
+
+   OP(95) // STA $00,X
+      ZPX; mem[ea] = a;
+      NEXT;
+
+   OP(96) // STX $00,Y
+      ZPY; mem[ea] = x;
+      NEXT;
+
+   OP(97) // SMB1 $00
+      ZP; mem[ea] |= 2;
+      NEXT;
+
+   OP(98) // TYA
+      a = y; nz = a;
+      NEXT;
+
+   OP(99) // STA $0000,Y
+      ABY; WRITE(ea, a);
+      NEXT;
+
+   OP(9A) // TXS
+      sp = x;
+      NEXT;
+
+   OP(9B) // NOP
+      NEXT;
+
+   OP(9C) // STZ $0000
+      ABS; WRITE(ea, 0);
+      NEXT;
+
+   OP(9D) // STA $0000,X
+      ABX; WRITE(ea, a);
+      NEXT;
+
+   OP(9E) // STZ $0000,X
+      ABX; WRITE(ea, 0);
+      NEXT;
+
+   OP(9F) // BBS1 $00
+      ZP; t = mem[ea]; BRANCH(t & 2);
+      NEXT;
+
+   OP(A0) // LDY #$00
+      y = mem[pc++]; nz = y;
+      NEXT;
+
+   OP(A1) // LDA ($00,X)
+      IZX; a = READ(ea); nz = a;
+      NEXT;
+
+   OP(A2) // LDX #$00
+      x = mem[pc++]; nz = x;
+      NEXT;
+
+   OP(A3) // NOP
+      NEXT;
+
+   OP(A4) // LDY $00
+      ZP; y = mem[ea]; nz = y;
+      NEXT;
+
+   OP(A5) // LDA $00
+      ZP; a = mem[ea]; nz = a;
+      NEXT;
+
+   OP(A6) // LDX $00
+      ZP; x = mem[ea]; nz = x;
+      NEXT;
+
+   OP(A7) // SMB2 $00
+      ZP; mem[ea] |= 4;
+      NEXT;
+
+   OP(A8) // TAY
+      y = a; nz = y;
+      NEXT;
+
+   OP(A9) // LDA #$00
+      a = mem[pc++]; nz = a;
+      NEXT;
+
+   OP(AA) // TAX
+      x = a; nz = x;
+      NEXT;
+
+   OP(AB) // NOP
+      NEXT;
+
+   OP(AC) // LDY $0000
+      ABS; y = READ(ea); nz = y;
+      NEXT;
+
+   OP(AD) // LDA $0000
+      ABS; a = READ(ea); nz = a;
+      NEXT;
+
+   OP(AE) // LDX $0000
+      ABS; x = READ(ea); nz = x;
+      NEXT;
+
+   OP(AF) // BBS2 $00
+      ZP; t = mem[ea]; BRANCH(t & 4);
+      NEXT;
+
+   OP(B0) // BCS
+      BRANCH(c);
+      NEXT;
+
+   OP(B1) // LDA ($00),Y
+      IZY; a = READ(ea); nz = a;
+      NEXT;
+
+   OP(B2) // LDA ($00)
+      IZP; a = READ(ea); nz = a;
+      NEXT;
+
+   OP(B3) // NOP
+      NEXT;
+
+   OP(B4) // LDY $00,X
+      ZPX; y = mem[ea]; nz = y;
+      NEXT;
+
+   OP(B5) // LDA $00,X
+      ZPX; a = mem[ea]; nz = a;
+      NEXT;
+
+   OP(B6) // LDX $00,Y
+      ZPY; x = mem[ea]; nz = x;
+      NEXT;
+
+   OP(B7) // SMB3 $00
+      ZP; mem[ea] |= 8;
+      NEXT;
+
+   OP(B8) // CLV
+      v = 0;
+      NEXT;
+
+   OP(B9) // LDA $0000,Y
+      ABY; a = READ(ea); nz = a;
+      NEXT;
+
+   OP(BA) // TSX
+      x = sp; nz = x;
+      NEXT;
+
+   OP(BB) // NOP
+      NEXT;
+
+   OP(BC) // LDY $0000,X
+      ABX; y = READ(ea); nz = y;
+      NEXT;
+
+   OP(BD) // LDA $0000,X
+      ABX; a = READ(ea); nz = a;
+      NEXT;
+
+   OP(BE) // LDX $0000,Y
+      ABY; x = READ(ea); nz = x;
+      NEXT;
+
+   OP(BF) // BBS3 $00
+      ZP; t = mem[ea]; BRANCH(t & 8);
+      NEXT;
+
+   OP(C0) // CPY #$00
+      COMPARE(y, mem[pc++]);
+      NEXT;
+
+   OP(C1) // CMP ($00,X)
+      IZX; COMPARE(a, READ(ea));
+      NEXT;
+
+   OP(C2) // NOP
+      pc++;
+      NEXT;
+
+   OP(C3) // NOP
+      NEXT;
+
+   OP(C4) // CPY $00
+      ZP; COMPARE(y, mem[ea]);
+      NEXT;
+
+   OP(C5) // CMP $00
+      ZP; COMPARE(a, mem[ea]);
+      NEXT;
+
+   OP(C6) // DEC $00
+      ZP; t = (uint8_t)(mem[ea] - 1); nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(C7) // SMB4 $00
+      ZP; mem[ea] |= 16;
+      NEXT;
+
+   OP(C8) // INY
+      y++; nz = y;
+      NEXT;
+
+   OP(C9) // CMP #$00
+      COMPARE(a, mem[pc++]);
+      NEXT;
+
+   OP(CA) // DEX
+      x--; nz = x;
+      NEXT;
+
+   OP(CB) // NOP (WAI)
+      NEXT;
+
+   OP(CC) // CPY $0000
+      ABS; COMPARE(y, READ(ea));
+      NEXT;
+
+   OP(CD) // CMP $0000
+      ABS; COMPARE(a, READ(ea));
+      NEXT;
+
+   OP(CE) // DEC $0000
+      ABS; t = (uint8_t)(READ(ea) - 1); nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(CF) // BBS4 $00
+      ZP; t = mem[ea]; BRANCH(t & 16);
+      NEXT;
+
+   OP(D0) // BNE
+      BRANCH(nz & 0xFF);
+      NEXT;
+
+   OP(D1) // CMP ($00),Y
+      IZY; COMPARE(a, READ(ea));
+      NEXT;
+
+   OP(D2) // CMP ($00)
+      IZP; COMPARE(a, READ(ea));
+      NEXT;
+
+   OP(D3) // NOP
+      NEXT;
+
+   OP(D4) // NOP
+      pc++;
+      NEXT;
+
+   OP(D5) // CMP $00,X
+      ZPX; COMPARE(a, mem[ea]);
+      NEXT;
+
+   OP(D6) // DEC $00,X
+      ZPX; t = (uint8_t)(mem[ea] - 1); nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(D7) // SMB5 $00
+      ZP; mem[ea] |= 32;
+      NEXT;
+
+   OP(D8) // CLD
+      d = 0;
+      NEXT;
+
+   OP(D9) // CMP $0000,Y
+      ABY; COMPARE(a, READ(ea));
+      NEXT;
+
+   OP(DA) // PHX
+      PUSH(x);
+      NEXT;
+
+   OP(DB) // NOP (STP)
+      NEXT;
+
+   OP(DC) // NOP
+      pc += 2;
+      NEXT;
+
+   OP(DD) // CMP $0000,X
+      ABX; COMPARE(a, READ(ea));
+      NEXT;
+
+   OP(DE) // DEC $0000,X
+      ABX; t = (uint8_t)(READ(ea) - 1); nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(DF) // BBS5 $00
+      ZP; t = mem[ea]; BRANCH(t & 32);
+      NEXT;
+
+   OP(E0) // CPX #$00
+      COMPARE(x, mem[pc++]);
+      NEXT;
+
+   OP(E1) // SBC ($00,X)
+      IZX; SBC(READ(ea));
+      NEXT;
+
+   OP(E2) // NOP
+      pc++;
+      NEXT;
+
+   OP(E3) // NOP
+      NEXT;
+
+   OP(E4) // CPX $00
+      ZP; COMPARE(x, mem[ea]);
+      NEXT;
+
+   OP(E5) // SBC $00
+      ZP; SBC(mem[ea]);
+      NEXT;
+
+   OP(E6) // INC $00
+      ZP; t = (uint8_t)(mem[ea] + 1); nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(E7) // SMB6 $00
+      ZP; mem[ea] |= 64;
+      NEXT;
+
+   OP(E8) // INX
+      x++; nz = x;
+      NEXT;
+
+   OP(E9) // SBC #$00
+      SBC(mem[pc++]);
+      NEXT;
+
+   OP(EA) // NOP
+      NEXT;
+
+   OP(EB) // NOP
+      NEXT;
+
+   OP(EC) // CPX $0000
+      ABS; COMPARE(x, READ(ea));
+      NEXT;
+
+   OP(ED) // SBC $0000
+      ABS; SBC(READ(ea));
+      NEXT;
+
+   OP(EE) // INC $0000
+      ABS; t = (uint8_t)(READ(ea) + 1); nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(EF) // BBS6 $00
+      ZP; t = mem[ea]; BRANCH(t & 64);
+      NEXT;
+
+   OP(F0) // BEQ
+      BRANCH(!(nz & 0xFF));
+      NEXT;
+
+   OP(F1) // SBC ($00),Y
+      IZY; SBC(READ(ea));
+      NEXT;
+
+   OP(F2) // SBC ($00)
+      IZP; SBC(READ(ea));
+      NEXT;
+
+   OP(F3) // NOP
+      NEXT;
+
+   OP(F4) // NOP
+      pc++;
+      NEXT;
+
+   OP(F5) // SBC $00,X
+      ZPX; SBC(mem[ea]);
+      NEXT;
+
+   OP(F6) // INC $00,X
+      ZPX; t = (uint8_t)(mem[ea] + 1); nz = t; mem[ea] = t;
+      NEXT;
+
+   OP(F7) // SMB7 $00
+      ZP; mem[ea] |= 128;
+      NEXT;
+
+   OP(F8) // SED
+      d = P_D;
+      NEXT;
+
+   OP(F9) // SBC $0000,Y
+      ABY; SBC(READ(ea));
+      NEXT;
+
+   OP(FA) // PLX
+      x = PULL(); nz = x;
+      NEXT;
+
+   OP(FB) // NOP
+      NEXT;
+
+   OP(FC) // NOP
+      pc += 2;
+      NEXT;
+
+   OP(FD) // SBC $0000,X
+      ABX; SBC(READ(ea));
+      NEXT;
+
+   OP(FE) // INC $0000,X
+      ABX; t = (uint8_t)(READ(ea) + 1); nz = t; WRITE(ea, t);
+      NEXT;
+
+   OP(FF) // BBS7 $00
+      ZP; t = mem[ea]; BRANCH(t & 128);
+      NEXT;
+
+}
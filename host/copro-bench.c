@@ -0,0 +1,372 @@
+/*
+ * 65C02 C core test runner and benchmark
+ *
+ * Runs the Dormann 6502 and 65C02 functional tests from programs.c on
+ * exec_65tubec() natively, without the Tube ROM. Just enough of the MOS is
+ * put at the top of memory for the tests:
+ *
+ * - OSWRCH (&FFEE) writes to &FEF9, which is collected as the test output
+ * - OSRDCH (&FFE0) reads &FEFB, which ends the run (the tests only ask for
+ *   a key once they have passed, or to continue after a failure)
+ * - IRQ/BRK (&FFFE) goes through IRQ1V and BRKV, like the Tube ROM
+ *
+ * A test passes if it prints "All tests completed". The instruction count
+ * and elapsed time give the host instructions per second of the core.
+ *
+ * A third workload, "loops", runs the kind of inner loops the OS and
+ * languages spend their time in (a page copy, a CR search, zero page copies
+ * and a delay loop), and passes if it gets to OSRDCH.
+ *
+ * It is built with BCD_TABLES, and first checks the decimal mode tables
+ * against the C core's reference ADC and SBC for every input.
+ *
+ * It is also built with TUBE_HLE, and last runs a program that calls OSWRCH,
+ * OSBYTE and OSWORD through the real Tube ROM, with every A from 0 to 255,
+ * against a host that is only sometimes ready. The tube accesses, memory and
+ * the registers and flags each call returns must be the same with the ROM
+ * code run natively as without.
+ *
+ * It is also built with COPRO_SNAPSHOT, and then runs the Tube ROM test
+ * again, stopping the core as if for a tube reset at every 97th status
+ * read and resuming it from the registers it left. The tube accesses, memory
+ * and final registers must be the same as for the test run straight through.
+ *
+ * Usage: copro-bench [-n repeats] [-t seconds]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "tube-defs.h"
+#include "tube.h"
+#include "tube-ula.h"
+#include "programs.h"
+#include "tuberom_6502.h"
+#include "copro-65tube.h"
+
+extern unsigned char mpu_memory[64*1024];
+
+extern uint64_t copro_65tubec_instructions;
+
+volatile int tube_irq;
+
+static char output[4096];
+static int output_len;
+
+// The minimal MOS entry points and vectors
+static const uint8_t mos_stub[] = {
+   // &FF00 IRQ/BRK: STA &FC, PLA, PHA, AND #&10, BNE brk, LDA &FC, JMP (&0204)
+   0x85, 0xFC, 0x68, 0x48, 0x29, 0x10, 0xD0, 0x05, 0xA5, 0xFC, 0x6C, 0x04, 0x02,
+   // brk: LDA &FC, JMP (&0202)
+   0xA5, 0xFC, 0x6C, 0x02, 0x02,
+   // &FF12 unclaimed vectors: STA &FEFA (fails the test), RTI
+   0x8D, 0xFA, 0xFE, 0x40
+};
+
+// The host for the Tube ROM test: status reads are random, with the ready
+// bits set seven times in eight, data reads are a sequence, and every access
+// goes into a checksum
+static int rom_host;
+static uint32_t rom_host_random;
+static uint8_t rom_host_data;
+static uint32_t rom_host_sum;
+static uint32_t rom_host_reads;
+static uint32_t rom_host_stop;
+static int rom_host_done;
+
+uint8_t tube_parasite_read(uint32_t addr) {
+   if (rom_host) {
+      uint8_t val;
+      if (addr & 1) {
+         val = rom_host_data += 0x3B;
+      } else {
+         rom_host_random = rom_host_random * 1103515245 + 12345;
+         val = rom_host_random >> 16;
+         if ((rom_host_random >> 24) & 7) {
+            val |= 0xC0;
+         }
+         if (rom_host_stop && ++rom_host_reads % rom_host_stop == 0) {
+            tube_irq |= RESET_BIT;
+         }
+      }
+      rom_host_sum = rom_host_sum * 31 + (((addr & 7) << 8) | val);
+      return val;
+   }
+   if ((addr & 7) == 3) {
+      // OSRDCH: the test has finished
+      tube_irq |= RESET_BIT;
+   }
+   return 'R';
+}
+
+void tube_parasite_write(uint32_t addr, uint8_t val) {
+   if (rom_host) {
+      rom_host_sum = rom_host_sum * 31 + (0x800 | ((addr & 7) << 8) | val);
+      if ((addr & 7) == 7) {
+         // The test has finished
+         rom_host_done = 1;
+         tube_irq |= RESET_BIT;
+      }
+      return;
+   }
+   if ((addr & 7) == 1) {
+      if (output_len < (int) sizeof(output) - 1) {
+         output[output_len++] = val;
+      }
+   } else {
+      printf("unexpected interrupt, PC on stack %02x%02x\r\n",
+             mpu_memory[0x103 + mpu_memory[0x1FF]], mpu_memory[0x102 + mpu_memory[0x1FF]]);
+      tube_irq |= RESET_BIT;
+   }
+}
+
+void tube_ack_nmi(void) {
+   tube_irq &= ~NMI_BIT;
+}
+
+static void timeout(int sig) {
+   (void) sig;
+   tube_irq |= RESET_BIT;
+}
+
+static double now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Inner loops at &2000, copying &5000 to &6000
+static const uint8_t loops[] = {
+   0xA9, 0x40, 0x85, 0x7F,             //        LDA #&40:STA &7F
+   0xA9, 0x00, 0x85, 0x70, 0x85, 0x72, //        LDA #0:STA &70:STA &72
+   0xA9, 0x50, 0x85, 0x71,             //        LDA #&50:STA &71
+   0xA9, 0x60, 0x85, 0x73,             //        LDA #&60:STA &73
+   0xA0, 0x00,                         // outer: LDY #0
+   0xB1, 0x70, 0x91, 0x72,             // copy:  LDA (&70),Y:STA (&72),Y
+   0xC8, 0xD0, 0xF9,                   //        INY:BNE copy
+   0xA0, 0x00,                         //        LDY #0
+   0xB1, 0x70, 0xC8,                   // find:  LDA (&70),Y:INY
+   0xC9, 0x0D, 0xD0, 0xF9,             //        CMP #&0D:BNE find
+   0xA5, 0x74, 0x85, 0x78,             //        LDA &74:STA &78
+   0xA5, 0x75, 0x85, 0x79,             //        LDA &75:STA &79
+   0xA5, 0x76, 0x85, 0x7A,             //        LDA &76:STA &7A
+   0xA5, 0x77, 0x85, 0x7B,             //        LDA &77:STA &7B
+   0xA0, 0x20,                         //        LDY #&20
+   0x88, 0xD0, 0xFD,                   // delay: DEY:BNE delay
+   0xC6, 0x7F, 0xD0, 0xD5,             //        DEC &7F:BNE outer
+   0x20, 0xE0, 0xFF                    //        JSR OSRDCH
+};
+
+// The Tube ROM test at &2000, recording A, X, Y and P after each call at &3000
+static const uint8_t rom_calls[] = {
+   0xA9, 0x00, 0x85, 0x70,                    // start: LDA #&00:STA &70
+   0xA9, 0x30, 0x85, 0x71,                    //        LDA #&30:STA &71
+   0xA2, 0x00,                                //        LDX #&00
+   0x86, 0x72,                                // loop:  STX &72
+   0x8A, 0x20, 0xEE, 0xFF, 0x20, 0x3F, 0x20,  //        TXA:JSR &FFEE:JSR rec
+   0xA5, 0x72, 0xC9, 0x8E, 0xF0, 0x0D,        //        LDA &72:CMP #&8E:BEQ noby
+   0x49, 0x55, 0xAA, 0xA4, 0x72, 0xA5, 0x72,  //        EOR #&55:TAX:LDY &72:LDA &72
+   0x20, 0xF4, 0xFF, 0x20, 0x3F, 0x20,        //        JSR &FFF4:JSR rec
+   0xA5, 0x72, 0xF0, 0x0A,                    // noby:  LDA &72:BEQ nowo
+   0xA2, 0x00, 0xA0, 0x40, 0x20, 0xF1, 0xFF,  //        LDX #&00:LDY #&40:JSR &FFF1
+   0x20, 0x3F, 0x20,                          //        JSR rec
+   0xA6, 0x72, 0xE8, 0xD0, 0xD1,              // nowo:  LDX &72:INX:BNE loop
+   0x8D, 0xFF, 0xFE,                          //        STA &FEFF
+   0x4C, 0x3C, 0x20,                          // stop:  JMP stop
+   0x08, 0x84, 0x74, 0xA0, 0x00, 0x91, 0x70,  // rec:   PHP:STY &74:LDY #&00:STA (&70),Y
+   0xC8, 0x8A, 0x91, 0x70,                    //        INY:TXA:STA (&70),Y
+   0xC8, 0xA5, 0x74, 0x91, 0x70,              //        INY:LDA &74:STA (&70),Y
+   0xC8, 0x68, 0x91, 0x70,                    //        INY:PLA:STA (&70),Y
+   0xA5, 0x70, 0x18, 0x69, 0x04, 0x85, 0x70,  //        LDA &70:CLC:ADC #&04:STA &70
+   0x90, 0x02, 0xE6, 0x71,                    //        BCC r1:INC &71
+   0x60                                       // r1:    RTS
+};
+
+enum { DORMANN_6502, DORMANN_65C02, LOOPS };
+
+static const char *test_names[] = { "Dormann 6502", "Dormann 65C02", "loops" };
+
+static void setup(int test) {
+   memset(mpu_memory, 0, sizeof(mpu_memory));
+   if (test == LOOPS) {
+      memcpy(mpu_memory + 0x2000, loops, sizeof(loops));
+      memset(mpu_memory + 0x5000, 'A', 0x100);
+      mpu_memory[0x5080] = 0x0D;
+   } else {
+      copy_dormann_test(mpu_memory, test == DORMANN_65C02);
+   }
+   memcpy(mpu_memory + 0xFF00, mos_stub, sizeof(mos_stub));
+   // OSRDCH: LDA &FEFB, RTS
+   memcpy(mpu_memory + 0xFFE0, "\xAD\xFB\xFE\x60", 4);
+   // OSWRCH: STA &FEF9, RTS
+   memcpy(mpu_memory + 0xFFEE, "\x8D\xF9\xFE\x60", 4);
+   // BRKV and IRQ1V
+   mpu_memory[0x202] = 0x12;
+   mpu_memory[0x203] = 0xFF;
+   mpu_memory[0x204] = 0x12;
+   mpu_memory[0x205] = 0xFF;
+   // NMI, RESET, IRQ/BRK
+   mpu_memory[0xFFFA] = 0x12;
+   mpu_memory[0xFFFB] = 0xFF;
+   mpu_memory[0xFFFC] = 0x00;
+   mpu_memory[0xFFFD] = test == LOOPS ? 0x20 : 0x34;
+   mpu_memory[0xFFFE] = 0x00;
+   mpu_memory[0xFFFF] = 0xFF;
+}
+
+static int run_test(int test, int repeats, int seconds) {
+   const char *name = test_names[test];
+   int passed = 1;
+   double elapsed = 0;
+   copro_65tubec_instructions = 0;
+   for (int i = 0; i < repeats && passed; i++) {
+      setup(test);
+      output_len = 0;
+      tube_irq = 0;
+      alarm(seconds);
+      double start = now();
+      exec_65tubec(mpu_memory, 0);
+      elapsed += now() - start;
+      alarm(0);
+      output[output_len] = 0;
+      if (test == LOOPS) {
+         passed = mpu_memory[0x6080] == 0x0D && mpu_memory[0x7F] == 0;
+      } else {
+         passed = strstr(output, "All tests completed") != NULL;
+      }
+   }
+   printf("%-14s: %s\r\n", name, passed ? "passed" : "FAILED");
+   if (!passed) {
+      printf("%s\r\n", output);
+   }
+   printf("%-14s  %llu instructions in %.3fs, %.1f MIPS\r\n", "",
+          (unsigned long long) copro_65tubec_instructions, elapsed,
+          copro_65tubec_instructions / elapsed / 1e6);
+   return passed;
+}
+
+static void setup_rom_calls() {
+   memset(mpu_memory, 0, sizeof(mpu_memory));
+   memcpy(mpu_memory + 0xF800, tuberom_6502_extern_1_10, 0x800);
+   // The vectors, as the ROM's reset code sets them
+   memcpy(mpu_memory + 0x200, mpu_memory + 0xFF80, 0x37);
+   memcpy(mpu_memory + 0x2000, rom_calls, sizeof(rom_calls));
+   // The OSWORD control block
+   for (int i = 0; i < 256; i++) {
+      mpu_memory[0x4000 + i] = i * 7;
+   }
+   mpu_memory[0xFFFC] = 0x00;
+   mpu_memory[0xFFFD] = 0x20;
+}
+
+static void rom_host_reset() {
+   rom_host = 1;
+   rom_host_random = 1;
+   rom_host_data = 0;
+   rom_host_sum = 0;
+   rom_host_reads = 0;
+   rom_host_done = 0;
+}
+
+static int run_rom_calls() {
+   static uint8_t memory[2][0x10000];
+   uint32_t sum[2];
+   uint64_t instructions[2];
+   double elapsed[2];
+   for (int hle = 0; hle < 2; hle++) {
+      setup_rom_calls();
+      copro_65tubec_hle = hle;
+      copro_65tubec_hle_calls = 0;
+      copro_65tubec_instructions = 0;
+      rom_host_reset();
+      tube_irq = 0;
+      double start = now();
+      exec_65tubec(mpu_memory, 0);
+      elapsed[hle] = now() - start;
+      rom_host = 0;
+      sum[hle] = rom_host_sum;
+      instructions[hle] = copro_65tubec_instructions;
+      memcpy(memory[hle], mpu_memory, sizeof(mpu_memory));
+   }
+   copro_65tubec_hle = 1;
+   int passed = sum[0] == sum[1] && !memcmp(memory[0], memory[1], sizeof(memory[0])) && copro_65tubec_hle_calls;
+   printf("%-14s: %s\r\n", "Tube ROM HLE", passed ? "passed" : "FAILED");
+   printf("%-14s  %llu instructions in %.3fs through the ROM, %llu in %.3fs with %lu native calls\r\n", "",
+          (unsigned long long) instructions[0], elapsed[0],
+          (unsigned long long) instructions[1], elapsed[1], (unsigned long) copro_65tubec_hle_calls);
+   return passed;
+}
+
+static int run_snapshots() {
+   static uint8_t memory[0x10000];
+   copro_65tube_regs_t regs;
+   uint32_t sum;
+   int stops = 0;
+   // Straight through
+   setup_rom_calls();
+   rom_host_reset();
+   tube_irq = 0;
+   exec_65tubec(mpu_memory, 0);
+   sum = rom_host_sum;
+   regs = copro_65tube_regs;
+   memcpy(memory, mpu_memory, sizeof(mpu_memory));
+   // Stopped and resumed
+   setup_rom_calls();
+   rom_host_reset();
+   rom_host_stop = 97;
+   while (!rom_host_done && stops < 100000) {
+      tube_irq = 0;
+      exec_65tubec(mpu_memory, 0);
+      copro_65tube_resume = 1;
+      stops++;
+   }
+   copro_65tube_resume = 0;
+   rom_host_stop = 0;
+   rom_host = 0;
+   int passed = rom_host_done && sum == rom_host_sum && !memcmp(&regs, &copro_65tube_regs, sizeof(regs)) &&
+                !memcmp(memory, mpu_memory, sizeof(memory));
+   printf("%-14s: %s\r\n", "Snapshots", passed ? "passed" : "FAILED");
+   printf("%-14s  resumed %d times, stopped at PC %04"PRIx32" A %02"PRIx32" X %02"PRIx32" Y %02"PRIx32" SP %02"PRIx32" P %02"PRIx32"\r\n",
+          "", stops - 1, copro_65tube_regs.pc, copro_65tube_regs.a, copro_65tube_regs.x,
+          copro_65tube_regs.y, copro_65tube_regs.sp, copro_65tube_regs.p);
+   return passed;
+}
+
+static void usage() {
+   printf("usage: copro-bench [-n repeats] [-t seconds]\r\n");
+}
+
+int main(int argc, char *argv[]) {
+   int repeats = 1;
+   int seconds = 60;
+   int opt;
+   while ((opt = getopt(argc, argv, "n:t:h")) != -1) {
+      switch (opt) {
+      case 'n':
+         repeats = atoi(optarg);
+         break;
+      case 't':
+         seconds = atoi(optarg);
+         break;
+      default:
+         usage();
+         return opt == 'h' ? 0 : 1;
+      }
+   }
+   signal(SIGALRM, timeout);
+   bcd_tables_init();
+   int errors = bcd_tables_check();
+   printf("%-14s: %s\r\n", "BCD tables", errors ? "FAILED" : "passed");
+   int passed = !errors;
+   for (int test = DORMANN_6502; test <= LOOPS; test++) {
+      passed &= run_test(test, repeats, seconds);
+   }
+   passed &= run_rom_calls();
+   passed &= run_snapshots();
+   return passed ? 0 : 1;
+}
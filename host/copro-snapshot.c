@@ -0,0 +1,266 @@
+/*
+ * Copro snapshot inspector
+ *
+ * Reads a snapshot taken with COPRO_SNAPSHOT (see copro-65tube.c) and
+ * prints the registers, the ULA state and a summary of the memory. It
+ * takes any of:
+ *
+ * - a UART log with a streamed snapshot in it (copro command 12, 3 or 4),
+ *   the lines between "SNAPSHOT <bytes>" and "SNAPSHOT END"
+ * - the flash region read back from the Pico, header sector then memory,
+ *   e.g. picotool save -r 0x101ef000 0x10200000 snapshot.bin (2MB flash)
+ * - a file written by -o, header then memory
+ *
+ * -d dumps len bytes (default 256) of the memory from addr (both hex).
+ *
+ * -m writes the 64KB of memory, e.g. for a disassembler.
+ *
+ * -o writes the snapshot as header then memory.
+ *
+ * Usage: copro-snapshot [-d addr[,len]] [-m memory.bin] [-o snapshot.bin] file
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include "tube-defs.h"
+#include "copro-65tube.h"
+
+#define MEM_SIZE 0x10000
+
+// The flash layout, a sector for the header then the memory
+#define FLASH_HEADER_SIZE 4096
+
+static copro_65tube_snapshot_t header;
+static uint8_t memory[MEM_SIZE];
+
+static uint8_t *read_file(const char *name, long *len) {
+   FILE *f = fopen(name, "rb");
+   uint8_t *data;
+   if (!f) {
+      perror(name);
+      return NULL;
+   }
+   fseek(f, 0, SEEK_END);
+   *len = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   data = malloc(*len + 1);
+   if (!data || fread(data, 1, *len, f) != (size_t) *len) {
+      fprintf(stderr, "%s: read failed\r\n", name);
+      fclose(f);
+      free(data);
+      return NULL;
+   }
+   data[*len] = 0;
+   fclose(f);
+   return data;
+}
+
+static int hex_nibble(int c) {
+   if (c >= '0' && c <= '9') return c - '0';
+   if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+   if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+   return -1;
+}
+
+// Collects the streamed bytes from a UART log into data (len bytes, as the
+// SNAPSHOT line gave). Returns the number of bytes seen, or -1.
+static long parse_log(char *log, uint8_t **data, long *len) {
+   char *line = strstr(log, "SNAPSHOT ");
+   long seen = 0;
+   if (!line) {
+      return -1;
+   }
+   *len = strtol(line + 9, NULL, 10);
+   if (*len <= 0) {
+      return -1;
+   }
+   *data = calloc(*len, 1);
+   for (line = strtok(line, "\r\n"); line; line = strtok(NULL, "\r\n")) {
+      char *p;
+      long offset;
+      if (!strcmp(line, "SNAPSHOT END")) {
+         break;
+      }
+      offset = strtol(line, &p, 16);
+      if (*p++ != ':') {
+         // Something else logged in the middle
+         continue;
+      }
+      for (; hex_nibble(p[0]) >= 0 && hex_nibble(p[1]) >= 0 && offset < *len; p += 2) {
+         (*data)[offset++] = (hex_nibble(p[0]) << 4) | hex_nibble(p[1]);
+         seen++;
+      }
+   }
+   return seen;
+}
+
+static int load(const char *name) {
+   long len, mem_offset;
+   uint8_t *file = read_file(name, &len);
+   uint8_t *data = file;
+   uint32_t magic = COPRO_SNAPSHOT_MAGIC;
+   int ok = 0;
+   if (!file) {
+      return 0;
+   }
+   if (len < 4 || memcmp(file, &magic, 4)) {
+      long seen = parse_log((char *) file, &data, &len);
+      if (seen < 0) {
+         fprintf(stderr, "%s: not a snapshot, or a log with one in\r\n", name);
+         data = file;
+         goto done;
+      }
+      if (seen != len) {
+         printf("Warning: log has %ld of the %ld bytes\r\n", seen, len);
+      }
+   }
+   memcpy(&header, data, len < (long) sizeof(header) ? len : (long) sizeof(header));
+   if (header.magic != COPRO_SNAPSHOT_MAGIC) {
+      fprintf(stderr, "%s: bad magic %08"PRIx32"\r\n", name, header.magic);
+      goto done;
+   }
+   if (header.version != COPRO_SNAPSHOT_VERSION) {
+      printf("Warning: version %"PRIu32", this reads version %d\r\n", header.version, COPRO_SNAPSHOT_VERSION);
+   }
+   mem_offset = len == FLASH_HEADER_SIZE + MEM_SIZE ? FLASH_HEADER_SIZE : (long) header.header_size;
+   if (mem_offset + MEM_SIZE > len) {
+      fprintf(stderr, "%s: %ld bytes is too short for the memory\r\n", name, len);
+      goto done;
+   }
+   memcpy(memory, data + mem_offset, MEM_SIZE);
+   ok = 1;
+done:
+   if (data != file) {
+      free(data);
+   }
+   free(file);
+   return ok;
+}
+
+static void print_flags(uint32_t p) {
+   static const char names[] = "NV-BDIZC";
+   for (int i = 0; i < 8; i++) {
+      putchar(p & (0x80 >> i) ? names[i] : '.');
+   }
+}
+
+static void print_snapshot() {
+   const copro_65tube_regs_t *r = &header.regs;
+   const tube_ula_snapshot_t *u = &header.ula;
+   uint32_t sum = copro_65tube_snapshot_sum(memory, MEM_SIZE);
+   printf("Snapshot version %"PRIu32" of copro %"PRIu32", speed %"PRIu32"MHz\r\n",
+          header.version, header.copro, header.copro_speed);
+   printf("Memory checksum %08"PRIx32" %s\r\n", sum, sum == header.mem_sum ? "ok" : "BAD");
+   printf("PC %04"PRIx32" A %02"PRIx32" X %02"PRIx32" Y %02"PRIx32" SP %02"PRIx32" P %02"PRIx32" ",
+          r->pc, r->a, r->x, r->y, r->sp, r->p);
+   print_flags(r->p);
+   printf("\r\nAt PC:");
+   for (int i = 0; i < 8; i++) {
+      printf(" %02x", memory[(r->pc + i) & 0xFFFF]);
+   }
+   printf("\r\nStack:");
+   for (uint32_t sp = r->sp + 1; sp < 0x100 && sp < r->sp + 17; sp++) {
+      printf(" %02x", memory[0x100 + sp]);
+   }
+   printf("\r\nVectors: NMI %04x RESET %04x IRQ %04x\r\n",
+          memory[0xFFFA] | (memory[0xFFFB] << 8), memory[0xFFFC] | (memory[0xFFFD] << 8),
+          memory[0xFFFE] | (memory[0xFFFF] << 8));
+   printf("ULA host status");
+   for (int i = 0; i < 4; i++) {
+      printf(" R%d %02x", i + 1, u->regs[i * 2]);
+   }
+   printf(", parasite status");
+   for (int i = 0; i < 4; i++) {
+      printf(" R%d %02x", i + 1, u->pstat[i]);
+   }
+   printf("\r\nULA data R1 %02x R2 %02x R3 %02x R4 %02x to the host, %02x %02x %02x%02x %02x from it\r\n",
+          u->regs[1], u->regs[3], u->regs[5], u->regs[7], u->hp1, u->hp2, u->hp3[0], u->hp3[1], u->hp4);
+   printf("ULA R1 ring %d queued, R3 %d to the parasite (second %02x) %d from it, IRQ %d NMI %d\r\n",
+          (uint8_t) (u->ph1_head - u->ph1_tail), u->ph3pos, u->ph3_1, u->hp3pos,
+          !!(u->irq & IRQ_BIT), !!(u->irq & NMI_BIT));
+}
+
+static void dump(uint32_t addr, uint32_t len) {
+   for (uint32_t i = 0; i < len; i += 16) {
+      printf("%04"PRIx32":", (addr + i) & 0xFFFF);
+      for (uint32_t j = i; j < i + 16 && j < len; j++) {
+         printf(" %02x", memory[(addr + j) & 0xFFFF]);
+      }
+      printf("  ");
+      for (uint32_t j = i; j < i + 16 && j < len; j++) {
+         uint8_t c = memory[(addr + j) & 0xFFFF];
+         putchar(c >= 32 && c < 127 ? c : '.');
+      }
+      printf("\r\n");
+   }
+}
+
+static int write_file(const char *name, const void *data1, size_t len1, const void *data2, size_t len2) {
+   FILE *f = fopen(name, "wb");
+   if (!f) {
+      perror(name);
+      return 0;
+   }
+   int ok = fwrite(data1, 1, len1, f) == len1 && (!len2 || fwrite(data2, 1, len2, f) == len2);
+   ok &= fclose(f) == 0;
+   if (!ok) {
+      fprintf(stderr, "%s: write failed\r\n", name);
+   }
+   return ok;
+}
+
+static void usage() {
+   printf("usage: copro-snapshot [-d addr[,len]] [-m memory.bin] [-o snapshot.bin] file\r\n");
+}
+
+int main(int argc, char *argv[]) {
+   const char *mem_name = NULL, *out_name = NULL;
+   long dump_addr = -1, dump_len = 256;
+   int opt;
+   while ((opt = getopt(argc, argv, "d:m:o:h")) != -1) {
+      switch (opt) {
+      case 'd': {
+         char *p;
+         dump_addr = strtol(optarg, &p, 16);
+         if (*p == ',') {
+            dump_len = strtol(p + 1, NULL, 16);
+         }
+         break;
+      }
+      case 'm':
+         mem_name = optarg;
+         break;
+      case 'o':
+         out_name = optarg;
+         break;
+      default:
+         usage();
+         return opt == 'h' ? 0 : 1;
+      }
+   }
+   if (optind != argc - 1) {
+      usage();
+      return 1;
+   }
+   if (!load(argv[optind])) {
+      return 1;
+   }
+   print_snapshot();
+   if (dump_addr >= 0) {
+      dump(dump_addr, dump_len);
+   }
+   if (mem_name && !write_file(mem_name, memory, MEM_SIZE, NULL, 0)) {
+      return 1;
+   }
+   if (out_name) {
+      header.header_size = sizeof(header);
+      if (!write_file(out_name, &header, sizeof(header), memory, MEM_SIZE)) {
+         return 1;
+      }
+   }
+   return header.mem_sum == copro_65tube_snapshot_sum(memory, MEM_SIZE) ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+// hardware/irq.h
+//
+// Host build stand-in for the Pico SDK header of the same name.
+
+#ifndef HOST_HARDWARE_IRQ_H
+#define HOST_HARDWARE_IRQ_H
+
+#include <stdbool.h>
+
+#define SIO_IRQ_PROC0 15
+#define PIO0_IRQ_0    7
+
+#define FIRST_USER_IRQ 26
+#define NUM_IRQS       32
+
+typedef void (*irq_handler_t)(void);
+
+extern irq_handler_t host_irq_handlers[NUM_IRQS];
+extern unsigned int host_user_irqs_claimed;
+
+// The simulator calls tube_io_handler() directly in place of the ISR, but
+// software pended interrupts run their handler straight away, as they would
+// on a single core with nothing of higher priority running
+static inline void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler) {
+   host_irq_handlers[num] = handler;
+}
+
+static inline void irq_set_pending(unsigned int num) {
+   if (host_irq_handlers[num]) {
+      host_irq_handlers[num]();
+   }
+}
+
+static inline int user_irq_claim_unused(bool required) {
+   (void) required;
+   return FIRST_USER_IRQ + host_user_irqs_claimed++;
+}
+
+static inline void irq_set_enabled(unsigned int num, bool enabled) {
+   (void) num;
+   (void) enabled;
+}
+
+#endif
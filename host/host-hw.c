@@ -0,0 +1,67 @@
+/*
+ * Host build stand-ins for the hardware side of the Pico Tube
+ *
+ * On the Pico these symbols come from tube.S and tube-client.c. The host
+ * simulator links tube-ula.c against this file instead, and drives
+ * host_gpio_in and tube_io_handler() itself.
+ *
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include "tube-defs.h"
+#include "tube.h"
+#include "hardware/irq.h"
+#include "tube-client.h"
+#include "copro-65tube.h"
+
+// nRST released, nTUBE and PHI2 idle high
+volatile uint32_t host_gpio_in = NRST_MASK | NTUBE_MASK | PHI2_MASK;
+
+volatile uint32_t host_time_us;
+
+// On the Pico the tube registers live in tube.S so the bus code can reach them
+uint8_t tube_regs[8] __attribute__((aligned(4)));
+
+volatile unsigned int copro;
+volatile unsigned int copro_speed;
+
+int arm_speed = 133;
+
+unsigned char mpu_memory[64*1024];
+
+void copro_mem_copy(int addr, const void *src, int len) {
+   memcpy(mpu_memory + addr, src, len);
+}
+
+// On the Pico the throttle waits for the wall clock (copro-65tube.c). Here
+// every block is granted straight away, as at full speed.
+int copro_65tube_cycle_budget;
+
+void copro_65tube_throttle(void) {
+   copro_65tube_cycle_budget = 0x40000000;
+}
+
+#ifdef COPRO_SNAPSHOT
+// On the Pico these live with the rest of the snapshot code in copro-65tube.c
+copro_65tube_regs_t copro_65tube_regs;
+
+int copro_65tube_resume;
+#endif
+
+irq_handler_t host_irq_handlers[NUM_IRQS];
+unsigned int host_user_irqs_claimed;
+
+void picofifo() {
+}
+
+void picotubecore() {
+}
+
+// Set when a tube status poll would wait for an event. The poll returns at
+// once, and tube-sim then holds the parasite until the wait would have ended.
+volatile int host_idle_wait;
+
+void tube_idle_wait() {
+   host_idle_wait = 1;
+}
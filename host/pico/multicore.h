@@ -0,0 +1,13 @@
+// pico/multicore.h
+//
+// Host build stand-in for the Pico SDK header of the same name.
+
+#ifndef HOST_PICO_MULTICORE_H
+#define HOST_PICO_MULTICORE_H
+
+// The simulator drives the bus from its own loop, so core1 is never started
+static inline void multicore_launch_core1(void (*entry)(void)) {
+   (void) entry;
+}
+
+#endif
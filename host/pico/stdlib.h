@@ -0,0 +1,40 @@
+// pico/stdlib.h
+//
+// Host build stand-in for the Pico SDK header of the same name.
+//
+// Only the small part of the SDK that the tube ULA code touches is
+// provided; the GPIO state is driven by the host simulator.
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+// Code placement attributes have no meaning on the host
+#define __time_critical_func(func) func
+#define __not_in_flash_func(func) func
+
+#define __compiler_memory_barrier() __asm__ volatile ("" : : : "memory")
+
+// Simulated GPIO input levels (bit n = GPIO n)
+extern volatile uint32_t host_gpio_in;
+
+// Simulated microsecond timer
+extern volatile uint32_t host_time_us;
+
+static inline uint32_t time_us_32(void) {
+   return host_time_us;
+}
+
+static inline void gpio_init(uint gpio) {
+   (void) gpio;
+}
+
+static inline bool gpio_get(uint gpio) {
+   return (host_gpio_in >> gpio) & 1;
+}
+
+#endif
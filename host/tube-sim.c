@@ -0,0 +1,937 @@
+/*
+ * Tube ULA host simulator and latency benchmark
+ *
+ * Builds tube-ula.c natively (see PICO_TUBE_HOST in CMakeLists.txt) and
+ * replays BBC host bus cycles into tube_io_handler(), exactly as the
+ * bus state machines would post them:
+ *
+ * - every cycle has nTUBE, RnW, A2:0 and D7:0
+ * - host writes are always posted
+ * - host reads drive the data bus from tube_regs[], and are only posted
+ *   when A0=1 (status reads have no side effects)
+ *
+ * A simple parasite model runs between host cycles so the FIFOs keep moving.
+ *
+ * For each register path the cost of tube_io_handler() is reported in host
+ * cycles (and host instructions where perf counters are available), along
+ * with the worst case and the tightest spacing between two posted accesses.
+ * The host figures are not RP2040 timings; they are a relative measure for
+ * catching timing-margin regressions before they reach a Beeb.
+ *
+ * Usage: tube-sim [-a] [-c] [-m 2|4] [-n repeats] [-t tracefile] [-v] [scenario ...]
+ *
+ * -a turns off the R3 transfer accelerator (TUBE_R3_ACCEL, built in with the
+ * TUBE_SIM_R3_ACCEL CMake option), so the load and save scenarios go through
+ * the Tube ROM's NMI handlers. The number of NMIs the 6502 would have taken
+ * is reported.
+ *
+ * -c posts the samples through tube_ula_core_service(), as the ULA core does
+ * with USE_ULA_CORE, rather than straight into tube_io_handler() as the ISR
+ * does. Either way the number of times core0 is interrupted is reported.
+ *
+ * -v checks the host access transition tables against the reference
+ * (branching) implementation over the whole compact state space.
+ *
+ * The status wake latency is the time from the start of a host access that
+ * changes a parasite status register to the end of the parasite's next
+ * status read. With TUBE_IDLE_WFE (the TUBE_SIM_IDLE_WFE CMake option) a
+ * status poll that would wait for an event holds the parasite model until
+ * the next posted sample, as the interrupt (or with -c, core1's event) would
+ * wake it, or for IDLE_WAIT_US of bus time.
+ *
+ * Trace files contain one bus cycle per line: "nTUBE RnW A2:0 D7:0" in hex,
+ * e.g. "0 0 1 41" is a write of &41 to &FEE1. Lines starting '#' are ignored.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include "tube-defs.h"
+#include "tube.h"
+#include "tube-ula.h"
+#include "tube-client.h"
+#include "tuberom_6502.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+extern uint8_t tube_regs[8];
+extern volatile int host_idle_wait;
+extern volatile uint32_t host_gpio_in;
+extern volatile uint32_t host_time_us;
+extern void tube_enable_fast6502(void);
+
+// ============================================================
+// Cost measurement
+// ============================================================
+
+static int perf_fd = -1;
+static double ns_per_tick;
+static uint64_t tick_overhead;
+static uint64_t instr_overhead;
+
+static inline uint64_t read_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+static inline uint64_t read_instr() {
+   uint64_t count = 0;
+   if (perf_fd >= 0 && read(perf_fd, &count, sizeof(count)) != sizeof(count)) {
+      count = 0;
+   }
+   return count;
+}
+
+static uint64_t monotonic_ns() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void measure_init() {
+#ifdef __linux__
+   struct perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.size = sizeof(attr);
+   attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   perf_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+
+   // Calibrate ticks against the monotonic clock
+   uint64_t ns0 = monotonic_ns();
+   uint64_t t0 = read_ticks();
+   while (monotonic_ns() - ns0 < 20000000);
+   uint64_t t1 = read_ticks();
+   ns_per_tick = (double)(monotonic_ns() - ns0) / (double)(t1 - t0);
+
+   // Measure the cost of an empty measurement
+   tick_overhead = UINT64_MAX;
+   instr_overhead = UINT64_MAX;
+   for (int i = 0; i < 1000; i++) {
+      uint64_t i0 = read_instr();
+      uint64_t a = read_ticks();
+      uint64_t b = read_ticks();
+      uint64_t i1 = read_instr();
+      if (b - a < tick_overhead) {
+         tick_overhead = b - a;
+      }
+      if (i1 - i0 < instr_overhead) {
+         instr_overhead = i1 - i0;
+      }
+   }
+}
+
+// ============================================================
+// Per register path statistics
+// ============================================================
+
+// Host paths are indexed by RnW:A2:0, then the reset path
+// Parasite paths follow, indexed by RnW:A2:0 (odd registers only)
+#define PATH_HOST      0
+#define PATH_RESET     16
+#define PATH_PARASITE  17
+#define NUM_PATHS      (PATH_PARASITE + 16)
+
+// Histogram buckets for the 99th percentile (one tick per bucket)
+#define HIST_SIZE      1024
+
+typedef struct {
+   uint64_t calls;
+   uint64_t min;
+   uint64_t max;
+   uint64_t sum;
+   uint64_t imin;
+   uint64_t imax;
+   uint32_t hist[HIST_SIZE + 1];
+} path_stats_t;
+
+static path_stats_t stats[NUM_PATHS];
+
+static const char *reg_names[8] = {
+   "R1 status", "R1 data", "R2 status", "R2 data",
+   "R3 status", "R3 data", "R4 status", "R4 data"
+};
+
+// Host writes to the even registers are the control and copro command registers
+static const char *host_write_names[8] = {
+   "R1 control", "R1 data", "copro cmd", "R2 data",
+   "copro cmd val", "R3 data", "copro select", "R4 data"
+};
+
+static void stats_reset() {
+   memset(stats, 0, sizeof(stats));
+   for (int i = 0; i < NUM_PATHS; i++) {
+      stats[i].min = UINT64_MAX;
+      stats[i].imin = UINT64_MAX;
+   }
+}
+
+static void stats_add_to(path_stats_t *s, uint64_t ticks, uint64_t instr) {
+   ticks = (ticks > tick_overhead) ? ticks - tick_overhead : 0;
+   instr = (instr > instr_overhead) ? instr - instr_overhead : 0;
+   s->calls++;
+   s->sum += ticks;
+   s->hist[ticks < HIST_SIZE ? ticks : HIST_SIZE]++;
+   if (ticks < s->min) {
+      s->min = ticks;
+   }
+   if (ticks > s->max) {
+      s->max = ticks;
+   }
+   if (instr < s->imin) {
+      s->imin = instr;
+   }
+   if (instr > s->imax) {
+      s->imax = instr;
+   }
+}
+
+static void stats_add(int path, uint64_t ticks, uint64_t instr) {
+   stats_add_to(&stats[path], ticks, instr);
+}
+
+// ============================================================
+// Bus model
+// ============================================================
+
+static int bus_mhz = 2;
+static uint64_t bus_cycles;          // total host bus cycles replayed
+static uint64_t last_posted = 0;     // bus cycle of the last posted sample
+static uint64_t min_spacing = UINT64_MAX;
+static uint64_t overruns;            // posted samples that cost more than the gap before the next
+static int ula_core;                 // samples go through the ULA core service loop (-c)
+static uint64_t posted;              // samples posted
+static uint64_t core0_interrupts;    // times the 6502 core would have been interrupted
+
+static uint64_t last_cost_ticks;
+
+// The parasite status wake latency
+static path_stats_t wake_stats;
+static int status_changed;           // a host access changed the status, not yet read
+static uint64_t status_changed_ticks;
+static uint64_t status_changed_cycle;
+static uint64_t wake_cycles;         // bus cycles from the changes to the reads
+
+#ifdef TUBE_IDLE_WFE
+// tube_idle_wait()'s timeout, IDLE_WAIT_US in tube-ula.c
+#define SIM_IDLE_WAIT_US 4
+
+static uint64_t parasite_asleep_until; // bus cycle the parasite's idle wait times out
+static uint64_t parasite_sleeps;
+#endif
+
+static void post_sample(uint32_t mail) {
+   int path;
+   if (((mail >> NRST_PIN) & 1) == 0) {
+      path = PATH_RESET;
+   } else {
+      path = PATH_HOST + (((mail >> RNW_PIN) & 1) << 3) + ((mail >> A0_PIN) & 7);
+   }
+
+   if (last_posted) {
+      uint64_t spacing = bus_cycles - last_posted;
+      if (spacing < min_spacing) {
+         min_spacing = spacing;
+      }
+      // Did the previous handler finish before this access arrived?
+      if (last_cost_ticks * ns_per_tick > spacing * 1000.0 / bus_mhz) {
+         overruns++;
+      }
+   }
+   last_posted = bus_cycles;
+
+   int signalled = 1;
+   uint32_t status = tube_parasite_status_peek();
+   uint64_t i0 = read_instr();
+   uint64_t t0 = read_ticks();
+   if (ula_core) {
+      signalled = tube_ula_core_service(mail);
+   } else {
+      tube_io_handler(mail);
+   }
+   uint64_t t1 = read_ticks();
+   uint64_t i1 = read_instr();
+   if (!status_changed && status != tube_parasite_status_peek()) {
+      status_changed = 1;
+      status_changed_ticks = t0;
+      status_changed_cycle = bus_cycles;
+   }
+#ifdef TUBE_IDLE_WFE
+   // The ISR (or core1's event) ends the wait
+   parasite_asleep_until = 0;
+#endif
+
+   posted++;
+   core0_interrupts += signalled;
+   last_cost_ticks = t1 - t0;
+   stats_add(path, t1 - t0, i1 - i0);
+}
+
+// One host bus cycle, as sampled towards the end of phase 2
+static uint8_t bus_cycle(int ntube, int rnw, int addr, uint8_t data) {
+   bus_cycles++;
+   host_time_us = bus_cycles / bus_mhz;
+   if (ntube) {
+      return data;
+   }
+   addr &= 7;
+   if (rnw) {
+      // The bus state machines drive the data bus from the tube_regs[] mirror
+      data = tube_regs[addr];
+      if (!(addr & 1)) {
+         return data;
+      }
+   }
+   post_sample(data | (addr << A0_PIN) | (rnw << RNW_PIN) | NRST_MASK | PHI2_MASK);
+   return data;
+}
+
+static void bus_reset() {
+   bus_cycles++;
+   host_gpio_in &= ~NRST_MASK;
+   post_sample((host_gpio_in & ~NTUBE_MASK) & 0xFFFF);
+   host_gpio_in |= NRST_MASK;
+}
+
+// ============================================================
+// Parasite model
+// ============================================================
+
+static int parasite_r1_pending;     // bytes the parasite still has to send on R1
+static uint8_t parasite_r1_next;
+static int parasite_r3_send;        // parasite to host R3 transfer active
+static uint8_t parasite_r3_next;
+static int parasite_r3_received;
+static uint8_t parasite_r3_expect;
+static int parasite_r2_received;
+static int parasite_r4_received;
+static int parasite_rom;            // R4 and NMI handled as the Tube ROM does (load/save)
+static int parasite_nmis;           // NMI handlers the 6502 ran
+static int parasite_rom_bytes;      // bytes moved by type 0-3 transfers
+static int errors;
+
+static uint8_t parasite_read(int addr) {
+   uint64_t i0 = read_instr();
+   uint64_t t0 = read_ticks();
+   uint8_t val = tube_parasite_read(addr);
+   uint64_t t1 = read_ticks();
+   uint64_t i1 = read_instr();
+   stats_add(PATH_PARASITE + 8 + addr, t1 - t0, i1 - i0);
+   if (status_changed && !(addr & 1)) {
+      status_changed = 0;
+      stats_add_to(&wake_stats, t1 - status_changed_ticks, 0);
+      wake_cycles += bus_cycles - status_changed_cycle;
+   }
+   return val;
+}
+
+static void parasite_write(int addr, uint8_t val) {
+   uint64_t i0 = read_instr();
+   uint64_t t0 = read_ticks();
+   tube_parasite_write(addr, val);
+   uint64_t t1 = read_ticks();
+   uint64_t i1 = read_instr();
+   stats_add(PATH_PARASITE + addr, t1 - t0, i1 - i0);
+}
+
+// The Tube ROM's R4 transfer command handler: type, client ID, then for
+// all but type 5 four address bytes, flushing R3, and a sync byte
+static void parasite_rom_r4(uint8_t val) {
+   static int seq;
+   static uint16_t ptr;
+   switch (seq) {
+   case 0:
+      if (val < 0x80) {
+         // Point the NMI vector at the handler and ptr at its transfer address
+         mpu_memory[0xFFFA] = mpu_memory[0xFE70 + val];
+         mpu_memory[0xFFFB] = mpu_memory[0xFE78 + val];
+         ptr = mpu_memory[0xFE60 + val] | (mpu_memory[0xFE68 + val] << 8);
+         seq = (val == 5) ? -1 : 1;
+      }
+      break;
+   case -1:
+      seq = 0;
+      break;
+   case 4:
+   case 5:
+      // Only the low 16 bits of the address are used, high byte first
+      mpu_memory[ptr + 5 - seq] = val;
+      if (++seq == 6) {
+         parasite_read(5);
+         parasite_read(5);
+      }
+      break;
+   case 6:
+      seq = 0;
+      break;
+   default:
+      seq++;
+      break;
+   }
+}
+
+// The Tube ROM's type 0-3 NMI handlers
+static void parasite_rom_nmi() {
+   uint16_t nmi = mpu_memory[0xFFFA] | (mpu_memory[0xFFFB] << 8);
+   uint16_t ptr;
+   int n = 1;
+   switch (nmi) {
+   case 0xFE00: ptr = 0xFE02; break;
+   case 0xFE11: ptr = 0xFE16; break;
+   case 0xFE22: ptr = 0x00F6; n = 2; break;
+   case 0xFE41: ptr = 0x00F6; n = 2; break;
+   default: return;
+   }
+   parasite_nmis++;
+   uint16_t addr = mpu_memory[ptr] | (mpu_memory[ptr + 1] << 8);
+   while (n--) {
+      if (nmi == 0xFE00 || nmi == 0xFE22) {
+         parasite_write(5, mpu_memory[addr++]);
+      } else {
+         mpu_memory[addr++] = parasite_read(5);
+      }
+   }
+   mpu_memory[ptr] = addr;
+   mpu_memory[ptr + 1] = addr >> 8;
+}
+
+// The parasite's work for one host bus cycle
+static void parasite_poll() {
+   // NMI: service R3 in the direction of the current transfer
+   if (tube_irq & NMI_BIT) {
+      tube_ack_nmi();
+      if (parasite_rom) {
+         parasite_rom_nmi();
+      } else if (parasite_r3_send) {
+         while (parasite_read(4) & 0x40) {
+            parasite_write(5, parasite_r3_next++);
+         }
+      } else {
+         while (parasite_read(4) & 0x80) {
+            uint8_t val = parasite_read(5);
+            if (val != parasite_r3_expect) {
+               printf("R3 data error: got %02x expected %02x\r\n", val, parasite_r3_expect);
+               errors++;
+            }
+            parasite_r3_expect++;
+            parasite_r3_received++;
+         }
+      }
+   }
+   // IRQ: R4 and R1 events from the host
+   if (tube_irq & IRQ_BIT) {
+      if (parasite_read(6) & 0x80) {
+         uint8_t val = parasite_read(7);
+         parasite_r4_received++;
+         if (parasite_rom) {
+            parasite_rom_r4(val);
+         }
+      }
+      if (parasite_read(0) & 0x80) {
+         parasite_read(1);
+      }
+   }
+   // R2 commands
+   if (parasite_read(2) & 0x80) {
+      uint8_t cmd = parasite_read(3);
+      parasite_r2_received++;
+      // Reply with the command byte inverted
+      if (parasite_read(2) & 0x40) {
+         parasite_write(3, cmd ^ 0xFF);
+      }
+   }
+   // OSWRCH stream on R1
+   if (parasite_r1_pending && (parasite_read(0) & 0x40)) {
+      parasite_write(1, parasite_r1_next++);
+      parasite_r1_pending--;
+   }
+}
+
+// Called between host bus cycles; the parasite is modelled as much faster than the host
+static void parasite_step() {
+#ifdef TUBE_IDLE_WFE
+   if (parasite_asleep_until) {
+      if (bus_cycles < parasite_asleep_until) {
+         return;
+      }
+      parasite_asleep_until = 0;
+   }
+#endif
+   parasite_poll();
+#ifdef TUBE_IDLE_WFE
+   // A status poll waited; the rest of this step stands in for the polls
+   // after it, so hold the parasite until the wait would have ended
+   if (host_idle_wait) {
+      host_idle_wait = 0;
+      parasite_sleeps++;
+      parasite_asleep_until = bus_cycles + SIM_IDLE_WAIT_US * bus_mhz;
+   }
+#endif
+}
+
+// ============================================================
+// Host model (the BBC MOS side of the tube)
+// ============================================================
+
+// gap non-tube cycles, then one tube access
+static uint8_t host_read(int addr, int gap) {
+   while (gap-- > 0) {
+      bus_cycle(1, 1, 0, 0);
+      parasite_step();
+   }
+   uint8_t val = bus_cycle(0, 1, addr, 0);
+   parasite_step();
+   return val;
+}
+
+static void host_write(int addr, uint8_t val, int gap) {
+   while (gap-- > 0) {
+      bus_cycle(1, 1, 0, 0);
+      parasite_step();
+   }
+   bus_cycle(0, 0, addr, val);
+   parasite_step();
+}
+
+// BIT &FEE0 / BPL loop followed by LDA &FEE1
+static int host_poll_r1(int limit) {
+   while (limit-- > 0) {
+      if (host_read(0, 3) & 0x80) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+static void host_tube_init() {
+   bus_reset();
+   tube_wait_for_rst_release();
+   // As exec_65tube() does when the 6502 starts
+   tube_enable_fast6502();
+   // MOS tube host code enables IRQ/NMI with &8E on FEE0
+   host_write(0, 0x8E, 4);
+}
+
+// Copro OSWRCH output: parasite streams bytes on R1, host polls and reads them
+static void scenario_oswrch(int n) {
+   uint8_t expect = 0;
+   parasite_r1_pending = n;
+   parasite_r1_next = 0;
+   for (int i = 0; i < n; i++) {
+      if (!host_poll_r1(1000)) {
+         printf("R1 stalled after %d bytes\r\n", i);
+         errors++;
+         return;
+      }
+      uint8_t val = host_read(1, 1);
+      if (val != expect) {
+         printf("R1 data error: got %02x expected %02x\r\n", val, expect);
+         errors++;
+      }
+      expect++;
+      // VDU driver time before the next poll
+      host_read(0, 20);
+   }
+}
+
+// Host sends R2 command bytes, the parasite replies on R2
+static void scenario_r2(int n) {
+   int start = parasite_r2_received;
+   for (int i = 0; i < n; i++) {
+      while (!(host_read(2, 3) & 0x40));
+      host_write(3, i, 2);
+      int timeout = 1000;
+      while (!(host_read(2, 3) & 0x80) && --timeout);
+      uint8_t val = host_read(3, 1);
+      if (val != (uint8_t)(i ^ 0xFF)) {
+         printf("R2 reply error: got %02x expected %02x\r\n", val, (uint8_t)(i ^ 0xFF));
+         errors++;
+      }
+   }
+   if (parasite_r2_received - start != n) {
+      printf("R2 command count error: %d of %d\r\n", parasite_r2_received - start, n);
+      errors++;
+   }
+}
+
+// 256 byte R3 transfers in both directions, in single and two byte mode
+static void scenario_r3(int blocks) {
+   for (int b = 0; b < blocks; b++) {
+      // M set, V set on odd blocks
+      uint8_t mode = (b & 1) ? 0x98 : 0x88;
+
+      // Host to parasite
+      int start = parasite_r3_received;
+      parasite_r3_send = 0;
+      parasite_r3_expect = 0;
+      host_write(0, mode, 4);
+      for (int i = 0; i < 256; i++) {
+         // LDA (zp),Y / STA &FEE5 / INY / BNE, waiting for space in R3
+         while (!(host_read(4, 3) & 0x40));
+         host_write(5, i, 7);
+      }
+      host_write(0, 0x18, 4);
+      if (parasite_r3_received - start != 256) {
+         printf("R3 host to parasite count error: %d of 256\r\n", parasite_r3_received - start);
+         errors++;
+      }
+
+      // Parasite to host: discard anything left in R3 first
+      while (host_read(4, 3) & 0x80) {
+         host_read(5, 1);
+      }
+      parasite_r3_send = 1;
+      parasite_r3_next = 0;
+      host_write(0, mode, 4);
+      for (int i = 0; i < 256; i++) {
+         // LDA &FEE5 / STA (zp),Y / INY / BNE, waiting for data in R3
+         while (!(host_read(4, 3) & 0x80));
+         uint8_t val = host_read(5, 1);
+         if (val != (uint8_t) i) {
+            printf("R3 parasite to host error: got %02x expected %02x\r\n", val, i);
+            errors++;
+            break;
+         }
+      }
+      parasite_r3_send = 0;
+      host_write(0, 0x18, 4);
+   }
+}
+
+// R4 events with the parasite IRQ enabled
+static void scenario_r4(int n) {
+   int start = parasite_r4_received;
+   for (int i = 0; i < n; i++) {
+      while (!(host_read(6, 3) & 0x40));
+      host_write(7, i, 2);
+      host_read(0, 10);
+   }
+   if (parasite_r4_received - start != n) {
+      printf("R4 event count error: %d of %d\r\n", parasite_r4_received - start, n);
+      errors++;
+   }
+}
+
+// Control register flag set/clear and soft reset
+static void scenario_control(int n) {
+   for (int i = 0; i < n; i++) {
+      for (int bit = 0; bit < 6; bit++) {
+         host_write(0, 0x80 | (1 << bit), 1);
+         host_write(0, 1 << bit, 1);
+      }
+      host_write(0, 0xC0, 1);
+      host_write(0, 0x40, 1);
+      host_write(0, 0x8E, 1);
+   }
+}
+
+// Elite style traffic: R1 output interleaved with back to back R2/R4 accesses
+static void scenario_elite(int n) {
+   parasite_r1_pending = n;
+   parasite_r1_next = 0;
+   for (int i = 0; i < n; i++) {
+      host_write(7, i, 1);
+      host_write(3, i, 1);
+      host_read(3, 0);
+      host_read(1, 0);
+      host_read(7, 0);
+   }
+   parasite_r1_pending = 0;
+}
+
+// Send a Tube transfer command on R4, as the host's Tube code does
+static void host_r4_command(const uint8_t *cmd, int len) {
+   for (int i = 0; i < len; i++) {
+      while (!(host_read(6, 3) & 0x40));
+      host_write(7, cmd[i], 2);
+   }
+}
+
+// *LOAD into the parasite: a type 1 (single byte, host to parasite) transfer
+// to &2000, serviced by the parasite's NMI handler for each byte
+static void scenario_load(int n) {
+   static const uint8_t start[] = { 0x01, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00 };
+   static const uint8_t release[] = { 0x05, 0x00 };
+   parasite_rom = 1;
+   memset(mpu_memory + 0x2000, 0, n);
+   host_r4_command(start, sizeof(start));
+   for (int i = 0; i < n; i++) {
+      // LDA (zp),Y / STA &FEE5 with a disc NMI's worth of time per byte
+      while (!(host_read(4, 3) & 0x40));
+      host_write(5, i * 7, 10);
+   }
+   host_r4_command(release, sizeof(release));
+   parasite_rom = 0;
+   for (int i = 0; i < n; i++) {
+      if (mpu_memory[0x2000 + i] != (uint8_t)(i * 7)) {
+         printf("load data error at %04x: got %02x expected %02x\r\n", 0x2000 + i, mpu_memory[0x2000 + i], (uint8_t)(i * 7));
+         errors++;
+         break;
+      }
+   }
+   parasite_rom_bytes += n;
+}
+
+// *SAVE from the parasite: a type 0 (single byte, parasite to host) transfer
+// from &3000. The host's first read of R3 only empties it to start the NMIs.
+static void scenario_save(int n) {
+   static const uint8_t start[] = { 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00 };
+   static const uint8_t release[] = { 0x05, 0x00 };
+   parasite_rom = 1;
+   for (int i = 0; i < n; i++) {
+      mpu_memory[0x3000 + i] = i * 3;
+   }
+   host_r4_command(start, sizeof(start));
+   host_read(5, 1);
+   for (int i = 0; i < n; i++) {
+      while (!(host_read(4, 3) & 0x80));
+      uint8_t val = host_read(5, 10);
+      if (val != (uint8_t)(i * 3)) {
+         printf("save data error at byte %d: got %02x expected %02x\r\n", i, val, (uint8_t)(i * 3));
+         errors++;
+         break;
+      }
+   }
+   host_r4_command(release, sizeof(release));
+   parasite_rom = 0;
+   parasite_rom_bytes += n;
+}
+
+typedef struct {
+   const char *name;
+   void (*run)(int);
+   int size;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+   { "oswrch",  scenario_oswrch,  1000 },
+   { "r2",      scenario_r2,       500 },
+   { "r3",      scenario_r3,         4 },
+   { "r4",      scenario_r4,       500 },
+   { "control", scenario_control,  100 },
+   { "elite",   scenario_elite,   1000 },
+   { "load",    scenario_load,    4096 },
+   { "save",    scenario_save,    4096 },
+   { NULL,      NULL,                0 }
+};
+
+// Replay a bus cycle trace file
+static int run_trace(const char *filename) {
+   FILE *f = fopen(filename, "r");
+   if (!f) {
+      perror(filename);
+      return -1;
+   }
+   char line[128];
+   unsigned int ntube, rnw, addr, data;
+   while (fgets(line, sizeof(line), f)) {
+      if (line[0] == '#') {
+         continue;
+      }
+      if (sscanf(line, "%x %x %x %x", &ntube, &rnw, &addr, &data) == 4) {
+         bus_cycle(ntube & 1, rnw & 1, addr, data);
+         parasite_step();
+      }
+   }
+   fclose(f);
+   return 0;
+}
+
+// ============================================================
+// Report
+// ============================================================
+
+// Host preemption makes the maximum noisy, so the worst case uses the 99th percentile
+static uint64_t stats_p99(path_stats_t *s) {
+   uint64_t target = s->calls - s->calls / 100;
+   uint64_t count = 0;
+   for (int i = 0; i < HIST_SIZE; i++) {
+      count += s->hist[i];
+      if (count >= target) {
+         return i;
+      }
+   }
+   return s->max;
+}
+
+static void report() {
+   double cycle_ns = 1000.0 / bus_mhz;
+   int worst = -1;
+   uint64_t worst_p99 = 0;
+   printf("\r\n%-26s %9s %7s %7s %7s %7s %7s %13s\r\n", "path", "calls", "min", "avg", "p99", "max", "p99 ns", "instr min/max");
+   for (int i = 0; i < NUM_PATHS; i++) {
+      path_stats_t *s = &stats[i];
+      if (!s->calls) {
+         continue;
+      }
+      char name[40];
+      if (i == PATH_RESET) {
+         snprintf(name, sizeof(name), "host nRST");
+      } else if (i < PATH_RESET) {
+         snprintf(name, sizeof(name), "host %c FEE%X %s", (i & 8) ? 'R' : 'W', i & 7,
+                  (i & 8) ? reg_names[i & 7] : host_write_names[i & 7]);
+      } else {
+         int p = i - PATH_PARASITE;
+         snprintf(name, sizeof(name), "para %c %s", (p & 8) ? 'R' : 'W', reg_names[p & 7]);
+      }
+      char instr[24];
+      if (perf_fd >= 0) {
+         snprintf(instr, sizeof(instr), "%" PRIu64 "/%" PRIu64, s->imin, s->imax);
+      } else {
+         snprintf(instr, sizeof(instr), "-");
+      }
+      uint64_t p99 = stats_p99(s);
+      printf("%-26s %9" PRIu64 " %7" PRIu64 " %7" PRIu64 " %7" PRIu64 " %7" PRIu64 " %7.0f %13s\r\n",
+             name, s->calls, s->min, s->sum / s->calls, p99, s->max, p99 * ns_per_tick, instr);
+      if (i <= PATH_RESET && (worst < 0 || p99 > worst_p99)) {
+         worst = i;
+         worst_p99 = p99;
+      }
+   }
+   printf("\r\n");
+   printf("host bus           : %dMHz (%.0fns per cycle), %" PRIu64 " cycles replayed\r\n", bus_mhz, cycle_ns, bus_cycles);
+   printf("tick               : %.3fns\r\n", ns_per_tick);
+   if (worst >= 0) {
+      if (worst == PATH_RESET) {
+         printf("worst host path    : nRST");
+      } else {
+         printf("worst host path    : %s FEE%X", (worst & 8) ? "read" : "write", worst & 7);
+      }
+      printf(", p99 %" PRIu64 " ticks (%.0fns)\r\n", worst_p99, worst_p99 * ns_per_tick);
+   }
+   if (min_spacing != UINT64_MAX) {
+      printf("tightest spacing   : %" PRIu64 " cycles (%.0fns)\r\n", min_spacing, min_spacing * cycle_ns);
+   }
+   printf("handler overruns   : %" PRIu64 "\r\n", overruns);
+   uint32_t pushes = tube_flush_stats.pushes[0] + tube_flush_stats.pushes[1];
+   printf("PIO mirror flushes : %" PRIu32 ", words pushed %" PRIu32 " (R1/R2 %" PRIu32 ", R3/R4 %" PRIu32 "), %" PRIu32 " of %" PRIu32 " word pushes avoided\r\n",
+          tube_flush_stats.requests, pushes, tube_flush_stats.pushes[0], tube_flush_stats.pushes[1],
+          tube_flush_stats.requests * 2 - pushes, tube_flush_stats.requests * 2);
+   printf("core0 interrupts   : %" PRIu64 " for %" PRIu64 " posted samples (%s)\r\n",
+          core0_interrupts, posted, ula_core ? "ULA on core1" : "ULA in core0 ISR");
+   if (parasite_rom_bytes) {
+#ifdef TUBE_R3_ACCEL
+      const char *accel = tube_r3_accel ? "on" : "off";
+#else
+      const char *accel = "not built";
+#endif
+      printf("R3 NMI transfers   : %d bytes, %d 6502 NMIs (accelerator %s)\r\n",
+             parasite_rom_bytes, parasite_nmis, accel);
+   }
+   uint64_t polls = 0;
+   for (int i = 0; i < 8; i += 2) {
+      polls += stats[PATH_PARASITE + 8 + i].calls;
+   }
+#ifdef TUBE_IDLE_WFE
+   printf("status polls       : %" PRIu64 ", %" PRIu32 " idle waits (TUBE_IDLE_WFE), %" PRIu64 " held to the next access or timeout\r\n",
+          polls, tube_idle_waits, parasite_sleeps);
+#else
+   printf("status polls       : %" PRIu64 " (no TUBE_IDLE_WFE)\r\n", polls);
+#endif
+   if (wake_stats.calls) {
+      printf("status wake latency: %" PRIu64 " changes, avg %" PRIu64 " p99 %" PRIu64 " ticks (%.0fns), avg %.2f bus cycles\r\n",
+             wake_stats.calls, wake_stats.sum / wake_stats.calls, stats_p99(&wake_stats),
+             stats_p99(&wake_stats) * ns_per_tick, (double) wake_cycles / wake_stats.calls);
+   }
+   printf("instruction counts : %s\r\n", perf_fd >= 0 ? "perf" : "unavailable (no perf counters)");
+}
+
+static void usage() {
+   printf("usage: tube-sim [-a] [-c] [-m 2|4] [-n repeats] [-t tracefile] [-v] [scenario ...]\r\n");
+   printf("scenarios:");
+   for (const scenario_t *s = scenarios; s->name; s++) {
+      printf(" %s", s->name);
+   }
+   printf("\r\n");
+}
+
+int main(int argc, char *argv[]) {
+   int repeats = 10;
+   const char *trace = NULL;
+   int opt;
+   while ((opt = getopt(argc, argv, "acm:n:t:vh")) != -1) {
+      switch (opt) {
+#ifdef TUBE_R3_ACCEL
+      case 'a':
+         tube_r3_accel = 0;
+         break;
+#endif
+      case 'c':
+         ula_core = 1;
+         break;
+      case 'v':
+         return tube_verify_tables() ? 1 : 0;
+      case 'm':
+         bus_mhz = atoi(optarg);
+         if (bus_mhz != 2 && bus_mhz != 4) {
+            usage();
+            return 1;
+         }
+         break;
+      case 'n':
+         repeats = atoi(optarg);
+         break;
+      case 't':
+         trace = optarg;
+         break;
+      default:
+         usage();
+         return 1;
+      }
+   }
+
+   measure_init();
+   stats_reset();
+   tube_init_hardware();
+   start_ula();
+   // The Tube ROM is copied to the top of 6502 memory when it starts
+   memcpy(mpu_memory + 0xF800, tuberom_6502_extern_1_10, 0x800);
+   host_tube_init();
+
+   if (trace) {
+      if (run_trace(trace) < 0) {
+         return 1;
+      }
+   } else {
+      for (int r = 0; r < repeats; r++) {
+         for (const scenario_t *s = scenarios; s->name; s++) {
+            int selected = (optind >= argc);
+            for (int i = optind; i < argc; i++) {
+               if (!strcmp(argv[i], s->name)) {
+                  selected = 1;
+               }
+            }
+            if (selected) {
+               s->run(s->size);
+            }
+         }
+      }
+   }
+
+   report();
+
+   if (errors) {
+      printf("%d data errors\r\n", errors);
+      return 1;
+   }
+   return 0;
+}
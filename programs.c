@@ -1,6 +1,7 @@
 #include <inttypes.h>
 #include <string.h>
 #include "tube-defs.h"
+#include "tube-client.h"
 //#include "gitversion.h"
 
 // if DORMANN_6502 is defined, the Dormann 6502 tests are included at #3400
@@ -2713,19 +2714,40 @@ static unsigned char dormann_d65c02[] = {
 
 #endif
 
-void copy_test_programs(uint8_t *memory) {
+// Copies with copro_mem_copy(), so with COPRO_MEM_DMA these are only queued
+#define COPY_STRING(addr, s) copro_mem_copy(addr, s, sizeof(s))
 
-   memcpy(memory + 0x800, sphere, sizeof(sphere));
+void copy_test_programs() {
 
-   strcpy((char *)memory + 0x805,        " PicoTubeDirect "RELEASENAME);
-   strcpy((char *)memory + 0x805 + 0x25, " Commit ID: "/*GITVERSION*/);
-   strcpy((char *)memory + 0x805 + 0x4A, " Pi: RP2040");
-   strcpy((char *)memory + 0x805 + 0x4F, " PICO" );
+   copro_mem_copy(0x800, sphere, sizeof(sphere));
 
-   memcpy(memory + 0x1000, clocksp, sizeof(clocksp));
+   COPY_STRING(0x805,        " PicoTubeDirect "RELEASENAME);
+   COPY_STRING(0x805 + 0x25, " Commit ID: "/*GITVERSION*/);
+   COPY_STRING(0x805 + 0x4A, " Pi: RP2040");
+   COPY_STRING(0x805 + 0x4F, " PICO" );
+
+   copro_mem_copy(0x1000, clocksp, sizeof(clocksp));
 #if defined(DORMANN_6502)
-   memcpy(memory + 0x3400, dormann_d6502, sizeof(dormann_d6502));
+   copro_mem_copy(0x3400, dormann_d6502, sizeof(dormann_d6502));
 #elif defined(DORMANN_65C02)
-   memcpy(memory + 0x3400, dormann_d65c02, sizeof(dormann_d65c02));
+   copro_mem_copy(0x3400, dormann_d65c02, sizeof(dormann_d65c02));
+#endif
+}
+
+// Install just one of the Dormann suites at #3400 (c02 selects the 65C02 one),
+// returning its size or 0 if it isn't built in
+int copy_dormann_test(uint8_t *memory, int c02) {
+#if defined(DORMANN_65C02)
+   if (c02) {
+      memcpy(memory + 0x3400, dormann_d65c02, sizeof(dormann_d65c02));
+      return sizeof(dormann_d65c02);
+   }
+#endif
+#if defined(DORMANN_6502)
+   if (!c02) {
+      memcpy(memory + 0x3400, dormann_d6502, sizeof(dormann_d6502));
+      return sizeof(dormann_d6502);
+   }
 #endif
+   return 0;
 }
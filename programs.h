@@ -3,6 +3,9 @@
 #ifndef PROGRAMS_H
 #define PROGRAMS_H
 
-extern void copy_test_programs(uint8_t *memory);
+// Copies the test programs into the copro's memory with copro_mem_copy()
+extern void copy_test_programs();
+
+extern int copy_dormann_test(uint8_t *memory, int c02);
 
 #endif
@@ -6,6 +6,7 @@
 #include "tube-defs.h"
 #include "tube.h"
 #include "tube-ula.h"
+#include "tube-client.h"
 
 typedef void (*func_ptr)();
 
@@ -27,6 +28,7 @@ static const char * emulator_names[] = {
    "65C02 (3MHz)",           // 1
    "65C102 (fast)",          // 2
    "65C102 (4MHz)",          // 3
+   "65C02 (C core)",         // 4
    "Null",                   // 5
    "Null",                   // 6
    "Null",                   // 7
@@ -61,7 +63,7 @@ static const func_ptr emulator_functions[] = {
    copro_65tube_emulator,    // 1
    copro_65tube_emulator,    // 2
    copro_65tube_emulator,    // 3
-   copro_null_emulator,      // 4
+   copro_65tubec_emulator,   // 4
    copro_null_emulator,      // 5
    copro_null_emulator,      // 6
    copro_null_emulator,      // 7
@@ -100,6 +102,107 @@ static func_ptr emulator;
 
 unsigned char mpu_memory[64*1024];
 
+#ifdef COPRO_MEM_DMA
+
+#include "hardware/dma.h"
+
+// Copro memory set up by DMA
+//
+// copro_mem_reset() and copro_mem_copy() queue their work as control blocks.
+// copro_mem_start() has one channel load each block in turn into the
+// alias 0 registers of another, which does the fill or copy and chains back
+// to the first, so the whole list runs in order while core0 waits out the
+// RST debounce. A null block (one with ctrl zero) ends the list.
+
+#define MEM_DMA_BLOCKS 16
+
+typedef struct {
+   const volatile void *read;
+   volatile void *write;
+   uint32_t count;
+   uint32_t ctrl;
+} mem_dma_block_t;
+
+static mem_dma_block_t mem_dma_blocks[MEM_DMA_BLOCKS + 1] __attribute__((aligned(16)));
+static int mem_dma_queued;
+static int mem_dma_running;
+static int mem_dma_data = -1;
+static int mem_dma_ctrl;
+static const uint32_t mem_dma_zero = 0;
+
+static void mem_dma_queue(const void *read, void *write, uint32_t len, int read_increment)
+{
+   dma_channel_config c;
+   mem_dma_block_t *b;
+   int words = !(((uintptr_t) read | (uintptr_t) write | len) & 3);
+
+   if (mem_dma_data < 0) {
+      mem_dma_data = dma_claim_unused_channel(true);
+      mem_dma_ctrl = dma_claim_unused_channel(true);
+   }
+   if (mem_dma_running || mem_dma_queued == MEM_DMA_BLOCKS) {
+      copro_mem_start();
+      copro_mem_wait();
+   }
+   c = dma_channel_get_default_config(mem_dma_data);
+   channel_config_set_transfer_data_size(&c, words ? DMA_SIZE_32 : DMA_SIZE_8);
+   channel_config_set_read_increment(&c, read_increment);
+   channel_config_set_write_increment(&c, true);
+   channel_config_set_chain_to(&c, mem_dma_ctrl);
+   channel_config_set_irq_quiet(&c, true);
+   b = &mem_dma_blocks[mem_dma_queued++];
+   b->read = read;
+   b->write = write;
+   b->count = words ? len >> 2 : len;
+   b->ctrl = channel_config_get_ctrl_value(&c);
+   memset(&mem_dma_blocks[mem_dma_queued], 0, sizeof(mem_dma_block_t));
+}
+
+unsigned char * copro_mem_reset(int length)
+{
+   // Wipe memory
+   mem_dma_queue(&mem_dma_zero, mpu_memory, length, 0);
+
+   // return pointer to memory
+   return mpu_memory;
+}
+
+void copro_mem_copy(int addr, const void *src, int len)
+{
+   mem_dma_queue(src, mpu_memory + addr, len, 1);
+}
+
+void copro_mem_start()
+{
+   dma_channel_config c;
+
+   if (!mem_dma_queued || mem_dma_running) {
+      return;
+   }
+   c = dma_channel_get_default_config(mem_dma_ctrl);
+   channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+   channel_config_set_read_increment(&c, true);
+   channel_config_set_write_increment(&c, true);
+   // Each block's four words wrap around READ_ADDR, WRITE_ADDR, TRANS_COUNT and CTRL_TRIG
+   channel_config_set_ring(&c, true, 4);
+   dma_channel_configure(mem_dma_ctrl, &c, &dma_hw->ch[mem_dma_data].read_addr, mem_dma_blocks, 4, true);
+   mem_dma_running = 1;
+}
+
+void copro_mem_wait()
+{
+   if (!mem_dma_running) {
+      return;
+   }
+   // The control channel stops once it has loaded the null block
+   while (dma_channel_is_busy(mem_dma_ctrl) ||
+          dma_hw->ch[mem_dma_ctrl].read_addr != (uintptr_t) &mem_dma_blocks[mem_dma_queued + 1]);
+   mem_dma_running = 0;
+   mem_dma_queued = 0;
+}
+
+#else
+
 unsigned char * copro_mem_reset(int length)
 {
    // Wipe memory
@@ -109,6 +212,21 @@ unsigned char * copro_mem_reset(int length)
    return mpu_memory;
 }
 
+void copro_mem_copy(int addr, const void *src, int len)
+{
+   memcpy(mpu_memory + addr, src, len);
+}
+
+void copro_mem_start()
+{
+}
+
+void copro_mem_wait()
+{
+}
+
+#endif
+
 void init_emulator() {
    emulator = emulator_functions[copro];
 }
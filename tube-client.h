@@ -3,6 +3,18 @@
 #ifndef TUBE_CLIENT_H
 #define TUBE_CLIENT_H
 
+extern unsigned char mpu_memory[64*1024];
+
 unsigned char * copro_mem_reset(int length);
 
+// Copies len bytes from src to addr in the copro's memory
+void copro_mem_copy(int addr, const void *src, int len);
+
+// With COPRO_MEM_DMA, copro_mem_reset() and copro_mem_copy() only queue
+// their work, which runs in order by DMA from copro_mem_start() (so that it
+// can overlap waiting for RST), until copro_mem_wait() returns
+void copro_mem_start();
+
+void copro_mem_wait();
+
 #endif
@@ -23,9 +23,49 @@
 #define COPRO_65TUBE_1   1
 #define COPRO_65TUBE_2   2
 #define COPRO_65TUBE_3   3
+#define COPRO_65TUBE_C   4
 
 #define DEFAULT_COPRO COPRO_65TUBE_0
 
+// Uncomment to run the Tube ULA on core1 (needs USE_PIO), leaving core0 to run only the 6502
+// #define USE_ULA_CORE
+
+// Hardware spinlock guarding the ULA state shared by both cores with USE_ULA_CORE
+#define ULA_SPINLOCK_ID 31
+
+// Hardware spinlock guarding the events core1 posts to core0 with USE_ULA_CORE
+#define ULA_EVENT_SPINLOCK_ID 30
+
+// Uncomment to let core0 wait for an event while the 6502 polls an unchanging tube status register
+// #define TUBE_IDLE_WFE
+
+// Uncomment to do decimal mode ADC and SBC by table lookup in the C 6502 core (2.5KB of RAM)
+// #define BCD_TABLES
+
+// Uncomment to run the Tube ROM's OSWRCH, OSBYTE and OSWORD natively in the C 6502 core
+// #define TUBE_HLE
+
+// Uncomment to build the 65tube opcode profiler (see copro_command_excute() for using it)
+// #define PROFILE6502
+
+// Uncomment to build the 65tube PC sampling profiler (see copro_command_excute() for using it)
+// #define PROFILE6502_PC
+
+// Uncomment to record every 65tube instruction into a RAM ring (see copro_command_excute() for using it)
+// #define TRACE6502
+
+// Uncomment to add the SysTick count to the instruction trace records
+// #define TRACE6502_SYSTICK
+
+// Uncomment to clear the copro's memory and copy in its ROM and test programs by DMA, while waiting for RST
+// #define COPRO_MEM_DMA
+
+// Uncomment to build copro snapshots, in flash or over the UART (see copro_command_excute() for using them)
+// #define COPRO_SNAPSHOT
+
+// Uncomment to drain the PIO bus samples through a DMA ring in batches (needs USE_PIO)
+// #define USE_PIO_DMA
+
 //
 // tube_irq bit definitions
 //
@@ -8,10 +8,15 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include "tube-defs.h"
 #include "tube.h"
 #include "tube-ula.h"
+#include "tube-client.h"
+#if defined(PROFILE6502) || defined(PROFILE6502_PC) || defined(COPRO_SNAPSHOT) || defined(TRACE6502)
+#include "copro-65tube.h"
+#endif
 
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
@@ -19,14 +24,46 @@
 
 inline void _disable_interrupts()
 {
+#ifndef PICO_TUBE_HOST
    __asm volatile ("cpsid i");
+#endif
 }
 
 inline void _enable_interrupts()
 {
+#ifndef PICO_TUBE_HOST
    __asm volatile ("cpsie i");
+#endif
 }
 
+// With USE_ULA_CORE the ULA state is shared with core1, so masking interrupts
+// on core0 isn't enough and a hardware spinlock is used instead
+
+#ifdef USE_ULA_CORE
+
+#if !defined(USE_PIO)
+#error "USE_ULA_CORE needs USE_PIO"
+#endif
+
+#include "hardware/sync.h"
+
+static spin_lock_t *ula_lock;
+
+// Guards the events core1 posts to core0 (see tube_ula_core_service()).
+// picofifo takes this on core0, so it can't be ula_lock, which core0 holds
+// with interrupts enabled.
+static spin_lock_t *ula_event_lock;
+
+#define ULA_LOCK()   spin_lock_unsafe_blocking(ula_lock)
+#define ULA_UNLOCK() spin_unlock_unsafe(ula_lock)
+
+#else
+
+#define ULA_LOCK()   _disable_interrupts()
+#define ULA_UNLOCK() _enable_interrupts()
+
+#endif
+
 // For predictable timing (i.e. stalling to to cache or memory contention)
 // we need to find somewhere in I/O space to place the tube registers.
 //
@@ -65,13 +102,44 @@ extern uint8_t tube_regs[8];
 
 static char copro_command =0;
 
-static uint8_t ph1[24],ph3_1;
-static uint8_t hp1,hp2,hp3[2],hp4;
+// Parasite to host R1 FIFO
+//
+// A single producer/single consumer ring. The parasite only writes ph1[] and
+// ph1_head; the host side (the ULA interrupt) only writes ph1_tail, PH1_0 and
+// HSTAT1. While HSTAT1 bit 7 is set PH1_0 holds a copy of ph1[ph1_tail].
+// A host reset empties the ring by moving ph1_tail up to ph1_head, so it
+// too leaves ph1_head to the parasite, and the append needs no lock.
+//
+// The indices run freely and are masked into the ring, so the wrap is a
+// single AND. The Tube only allows 24 bytes in flight, which is what the
+// parasite sees as the R1 not full flag.
+
+#define PH1_RING_SIZE 32
+#define PH1_RING_MASK (PH1_RING_SIZE - 1)
+#define PH1_CAPACITY  24
+
+static uint8_t ph1[PH1_RING_SIZE];
+static volatile uint8_t ph1_head, ph1_tail;
+#ifndef USE_ULA_CORE
+static uint ph1_publish_irq;      // (the ULA core polls instead)
+#endif
+
+static uint8_t ph3_1;
+static uint8_t hp1,hp2,hp3[3],hp4; // hp3[2] is a sink for writes to a full R3
 static uint8_t pstat[4];
 static uint8_t ph3pos,hp3pos;
-static uint8_t ph1rdpos,ph1wrpos,ph1len;
 volatile int tube_irq;
 
+#ifdef TUBE_R3_ACCEL
+int tube_r3_accel = 1;              // copro command 9 turns this off for comparison
+static int8_t r3_accel_type = -1;   // transfer type the ULA is servicing, -1 if none
+static uint16_t r3_accel_ptr;       // where the NMI handler keeps the transfer address
+static uint8_t r4_seq, r4_type;     // parasite R4 reads into a transfer command
+#define R3_ACCEL_STOP() (r3_accel_type = -1)
+#else
+#define R3_ACCEL_STOP()
+#endif
+
 // Host end of the fifos are the ones read by the tube isr
 #define PH1_0 tube_regs[1]
 #define PH2   tube_regs[3]
@@ -98,6 +166,70 @@ volatile int tube_irq;
 
 #define NUM_PINS 15
 
+#ifdef USE_PIO_DMA
+
+#if defined(USE_ULA_CORE)
+#error "USE_PIO_DMA and USE_ULA_CORE are alternatives"
+#endif
+
+#include "hardware/dma.h"
+
+// Bus sample ring (USE_PIO_DMA)
+//
+// One DMA channel copies every sample from the PIO0 SM3 RX FIFO into
+// bus_ring[], with the write address wrapping in hardware. Each time it has
+// done a lap a second channel re-arms its transfer count, so it runs forever
+// (the RX FIFO covers the couple of cycles this takes).
+//
+// The RX not empty interrupt still fires for the first sample, but the ISR
+// then handles everything in the ring, including samples that arrive while
+// it is running. A burst of host accesses such as a 256 byte R3 transfer
+// costs one ISR entry, and each sample is still handled in order as soon as
+// the ISR gets to it, so the R1/R3 read-ahead is no later than before.
+
+#define BUS_RING_BITS 6
+#define BUS_RING_SIZE (1 << BUS_RING_BITS) // samples
+
+static uint32_t bus_ring[BUS_RING_SIZE] __attribute__((aligned(BUS_RING_SIZE * 4)));
+static const uint32_t bus_ring_lap = BUS_RING_SIZE;
+static uint bus_ring_dma;
+static uint32_t bus_ring_rd;
+
+tube_ring_stats_t tube_ring_stats;
+
+static void bus_ring_init(PIO p0) {
+   uint rearm_dma;
+   dma_channel_config c;
+
+   bus_ring_dma = dma_claim_unused_channel(true);
+   rearm_dma = dma_claim_unused_channel(true);
+
+   // Re-arm the ring channel's transfer count and re-trigger it
+   c = dma_channel_get_default_config(rearm_dma);
+   channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+   channel_config_set_read_increment(&c, false);
+   channel_config_set_write_increment(&c, false);
+   dma_channel_configure(rearm_dma, &c, &dma_hw->ch[bus_ring_dma].al1_transfer_count_trig,
+                         &bus_ring_lap, 1, false);
+
+   // RX FIFO of SM3 into the ring
+   c = dma_channel_get_default_config(bus_ring_dma);
+   channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+   channel_config_set_read_increment(&c, false);
+   channel_config_set_write_increment(&c, true);
+   channel_config_set_ring(&c, true, BUS_RING_BITS + 2);
+   channel_config_set_dreq(&c, pio_get_dreq(p0, 3, false));
+   channel_config_set_chain_to(&c, rearm_dma);
+   dma_channel_configure(bus_ring_dma, &c, bus_ring, &p0->rxf[3], BUS_RING_SIZE, true);
+}
+
+static inline uint32_t bus_ring_depth() {
+   uint32_t wr = (dma_hw->ch[bus_ring_dma].write_addr - (uintptr_t) bus_ring) >> 2;
+   return (wr - bus_ring_rd) & (BUS_RING_SIZE - 1);
+}
+
+#endif
+
 static void pio_init(PIO p0, PIO p1, uint pin) {
 
    // Load the Control program
@@ -187,6 +319,10 @@ static void pio_init(PIO p0, PIO p1, uint pin) {
    for (uint sm = 0; sm < 4; sm++) {
       pio_sm_set_enabled(p1, sm, true);
    }
+
+#ifdef USE_PIO_DMA
+   bus_ring_init(p0);
+#endif
 }
 
 static inline void set_x(PIO pio, uint sm, uint32_t x) {
@@ -196,65 +332,348 @@ static inline void set_x(PIO pio, uint sm, uint32_t x) {
    pio_sm_exec(pio, sm, pio_encode_pull(false, false));
 }
 
+#define PUSH_TUBE_WORD(sm, x) set_x(pio1, sm, x)
+
+#elif defined(PICO_TUBE_HOST)
+
+// No PIO on the host, but the mirror is kept so tube-sim can count the pushes
+#define PUSH_TUBE_WORD(sm, x)
+
+#endif
+
+#if defined(USE_PIO) || defined(PICO_TUBE_HOST)
+
+// PIO1 SM2 holds tube_regs[0..3] and SM3 holds tube_regs[4..7] in their OSRs.
+//
+// tube_regs_mirror[] is what was last pushed to each, so a flush only has to
+// push the halves where a register has changed (most updates only touch
+// one). The host access handlers leave the flush to tube_io_handler(), so an
+// R3 accelerator NMI run inside an access, or a whole batch of bus samples
+// drained by tube_drain_bus_ring(), ends in at most one push of each word.
+//
+// The mirror and the OSRs must change together, so every flush has to be
+// made with the ULA locked. A host access landing between the mirror update
+// and the push would otherwise leave an old word in the OSR for good, as
+// later flushes would find the mirror already matching.
+
+static uint32_t tube_regs_mirror[2];
+
+#if defined(TUBE_COUNTERS) || defined(PICO_TUBE_HOST)
+tube_flush_stats_t tube_flush_stats;
+#define FLUSH_COUNT(c) tube_flush_stats.c++
+#else
+#define FLUSH_COUNT(c)
+#endif
+
 static inline void FLUSH_TUBE_REGS() {
-   uint32_t *p = (uint32_t *)(&tube_regs);
-   set_x(pio1, 2, *p++);
-   set_x(pio1, 3, *p++);
+   const uint32_t *p = (const uint32_t *)(&tube_regs);
+   uint32_t lo = p[0];
+   uint32_t hi = p[1];
+   FLUSH_COUNT(requests);
+   if (lo != tube_regs_mirror[0]) {
+      tube_regs_mirror[0] = lo;
+      PUSH_TUBE_WORD(2, lo);
+      FLUSH_COUNT(pushes[0]);
+   }
+   if (hi != tube_regs_mirror[1]) {
+      tube_regs_mirror[1] = hi;
+      PUSH_TUBE_WORD(3, hi);
+      FLUSH_COUNT(pushes[1]);
+   }
 }
 
 #else
 #define FLUSH_TUBE_REGS(...)
 #endif
 
+#ifdef TUBE_COUNTERS
+
+// Each update is a single increment, mostly of an indexed counter, so the
+// hot paths don't gain any branches
+
+tube_counters_t tube_counters;
+
+static int tube_counters_dump_pending;
+
+#define TUBE_COUNT(c) tube_counters.c++
+
+void tube_dump_counters()
+{
+   const tube_counters_t *c = &tube_counters;
+   int high_water = 0;
+   for (int i = 0; i < 25; i++) {
+      // A write with 24 bytes already in the FIFO is dropped
+      if (c->r1_depth[i]) high_water = (i < 24) ? i + 1 : i;
+   }
+   LOG_INFO("Tube counters\r\n");
+   LOG_INFO("addr   host rd   host wr   para rd   para wr\r\n");
+   for (int i = 0; i < 8; i++) {
+      LOG_INFO("FEE%d %9"PRIu32" %9"PRIu32" %9"PRIu32" %9"PRIu32"\r\n", i,
+               c->host_reads[i], c->host_writes[i], c->parasite_reads[i], c->parasite_writes[i]);
+   }
+   LOG_INFO("R1 FIFO high water %d bytes\r\n", high_water);
+   LOG_INFO("IRQ raised %"PRIu32", NMI raised %"PRIu32"\r\n",
+            c->raised[IRQ_BIT] + c->raised[IRQ_BIT | NMI_BIT], c->raised[NMI_BIT] + c->raised[IRQ_BIT | NMI_BIT]);
+   LOG_INFO("Resets %"PRIu32", R3 mode switches %"PRIu32"\r\n", c->resets, c->r3_mode[1]);
+}
+
+#else
+#define TUBE_COUNT(c)
+#endif
+
+#ifdef DEBUG_TRANSFERS
+
+tube_transfer_sums_t tube_transfer_sums;
+
+static int tube_transfer_sums_dump_pending;
+
+static inline void checksum_add(tube_checksum_t *c, uint8_t val)
+{
+   c->count++;
+   c->sum1 += val;
+   c->sum2 += c->sum1;
+}
+
+#define CHECKSUM(channel, reg, val) checksum_add(&tube_transfer_sums.channel[reg], val)
+
+static void dump_transfer_pair(const char *dir, int reg, const tube_checksum_t *in, const tube_checksum_t *out)
+{
+   LOG_INFO("R%d %s in %9"PRIu32" %04x %04x  out %9"PRIu32" %04x %04x  %s\r\n", reg + 1, dir,
+            in->count, in->sum1, in->sum2, out->count, out->sum1, out->sum2,
+            memcmp(in, out, sizeof(*in)) ? "DIFFER" : "ok");
+}
+
+void tube_dump_transfer_sums()
+{
+   const tube_transfer_sums_t *t = &tube_transfer_sums;
+   LOG_INFO("Tube transfer checksums (count sum1 sum2)\r\n");
+   for (int i = 0; i < 4; i++) {
+      dump_transfer_pair("host->para", i, &t->host_wr[i], &t->para_rd[i]);
+      dump_transfer_pair("para->host", i, &t->para_wr[i], &t->host_rd[i]);
+   }
+}
+
+#else
+#define CHECKSUM(channel, reg, val)
+#endif
+
+#ifdef DEBUG_TUBE
+
+// Tube access trace (DEBUG_TUBE)
+//
+// Each data register access is two stores into a RAM ring, so tracing
+// doesn't disturb the timing being traced. The host and parasite sides each
+// have their own ring (with USE_ULA_CORE they run on different cores), and
+// the dump merges them by timestamp.
+//
+// data bits 0-2 register, bit 3 read, bit 4 reset, bits 8-15 value,
+// bits 16-20 R1 FIFO bytes, bits 21-22 ph3pos, bits 23-24 hp3pos
+// (the FIFO state is after the access, except for host reads where it is
+// before, as the value is the read-ahead the host was given)
+
+#define TRACE_BITS 10
+#define TRACE_SIZE (1 << TRACE_BITS)
+
+#define TRACE_HOST     0
+#define TRACE_PARASITE 1
+
+#define TRACE_READ  0x08
+#define TRACE_RESET 0x10
+
+typedef struct {
+   uint32_t time;  // us
+   uint32_t data;
+} tube_trace_t;
+
+static tube_trace_t tube_trace[2][TRACE_SIZE];
+static uint32_t tube_trace_pos[2];
+static int tube_trace_dump_pending;
+
+static inline void trace_add(int side, uint32_t op, uint8_t val)
+{
+   tube_trace_t *t = &tube_trace[side][tube_trace_pos[side]++ & (TRACE_SIZE - 1)];
+   t->time = time_us_32();
+   t->data = op | (val << 8) | ((uint8_t)(ph1_head - ph1_tail) << 16) | (ph3pos << 21) | (hp3pos << 23);
+}
+
+#define TRACE(side, op, val) trace_add(side, op, val)
+
+// Decode the last n entries of each side (all of them if n is 0)
+void tube_trace_dump(int n)
+{
+   uint32_t pos[2];
+   for (int side = 0; side < 2; side++) {
+      uint32_t count = tube_trace_pos[side];
+      if (count > TRACE_SIZE) count = TRACE_SIZE;
+      if (n > 0 && count > (uint32_t) n) count = n;
+      pos[side] = tube_trace_pos[side] - count;
+   }
+   LOG_INFO("Tube trace\r\n");
+   while (pos[0] != tube_trace_pos[0] || pos[1] != tube_trace_pos[1]) {
+      int side;
+      if (pos[0] == tube_trace_pos[0]) {
+         side = TRACE_PARASITE;
+      } else if (pos[1] == tube_trace_pos[1]) {
+         side = TRACE_HOST;
+      } else {
+         const tube_trace_t *h = &tube_trace[TRACE_HOST][pos[0] & (TRACE_SIZE - 1)];
+         const tube_trace_t *p = &tube_trace[TRACE_PARASITE][pos[1] & (TRACE_SIZE - 1)];
+         side = ((int32_t)(p->time - h->time) < 0) ? TRACE_PARASITE : TRACE_HOST;
+      }
+      const tube_trace_t *t = &tube_trace[side][pos[side]++ & (TRACE_SIZE - 1)];
+      uint32_t d = t->data;
+      if (d & TRACE_RESET) {
+         LOG_INFO("%10"PRIu32" %s reset\r\n", t->time, side ? "para" : "host");
+      } else {
+         LOG_INFO("%10"PRIu32" %s %c R%"PRIu32"%s %02"PRIx32"  R1 %2"PRIu32" ph3 %"PRIu32" hp3 %"PRIu32"\r\n",
+                  t->time, side ? "para" : "host", (d & TRACE_READ) ? 'R' : 'W',
+                  ((d & 7) >> 1) + 1, (d & 1) ? "   " : " ct", (d >> 8) & 0xFF,
+                  (d >> 16) & 0x1F, (d >> 21) & 3, (d >> 23) & 3);
+      }
+   }
+}
+
+#else
+#define TRACE(side, op, val)
+#endif
+
 void tube_enable_fast6502(void)
 {
-   _disable_interrupts();
+   ULA_LOCK();
    tube_irq |= FAST6502_BIT;
-   _enable_interrupts();
+   ULA_UNLOCK();
 }
 
 void tube_disable_fast6502(void)
 {
-   _disable_interrupts();
+   ULA_LOCK();
    tube_irq &= ~FAST6502_BIT;
-   _enable_interrupts();
+   ULA_UNLOCK();
 }
 
 void tube_ack_nmi(void)
 {
-   _disable_interrupts();
+   ULA_LOCK();
    tube_irq &= ~NMI_BIT;
-   _enable_interrupts();
+   ULA_UNLOCK();
 }
 
 void copro_command_excute(unsigned char copro_command,unsigned char val)
 {
     switch (copro_command)
     {
-      case 0 :
-          if (val == 0)
-             copro_speed = 0;
-          else
-             copro_speed = (arm_speed/(1000000/256) / val);
-          LOG_DEBUG("New Copro speed= %u, %u\r\n", val, copro_speed);
+      case 0 : // *fx 151,226,0 followed by *fx 151,228,MHz
+               // Set the speed of the speed limited copros (0 for full speed)
+          copro_speed = val;
+          LOG_DEBUG("New Copro speed= %u MHz\r\n", copro_speed);
           return;
       case 1 : // *fx 151,226,1 followed by *fx 151,228,val
                // Select memory size
                copro = copro | 128 ;  // Set bit 7 to signal full reset of core
                return;
+#ifdef TUBE_COUNTERS
+      case 2 : // *fx 151,226,2 followed by *fx 151,228,page
+               // Copy the tube counters to &page00 in the Co Pro memory
+               memcpy(mpu_memory + (val << 8), &tube_counters, sizeof(tube_counters));
+               return;
+      case 3 : // *fx 151,226,3 followed by *fx 151,228,0
+               // Dump the tube counters over the UART at the next tube reset
+               tube_counters_dump_pending = 1;
+               return;
+      case 4 : // *fx 151,226,4 followed by *fx 151,228,0
+               // Reset the tube counters
+               memset(&tube_counters, 0, sizeof(tube_counters));
+               return;
+#endif
+#ifdef DEBUG_TRANSFERS
+      case 5 : // *fx 151,226,5 followed by *fx 151,228,page
+               // Copy the transfer checksums to &page00 in the Co Pro memory
+               memcpy(mpu_memory + (val << 8), &tube_transfer_sums, sizeof(tube_transfer_sums));
+               return;
+      case 6 : // *fx 151,226,6 followed by *fx 151,228,0
+               // Dump the transfer checksums over the UART at the next tube reset
+               tube_transfer_sums_dump_pending = 1;
+               return;
+      case 7 : // *fx 151,226,7 followed by *fx 151,228,0
+               // Reset the transfer checksums
+               memset(&tube_transfer_sums, 0, sizeof(tube_transfer_sums));
+               return;
+#endif
+#ifdef DEBUG_TUBE
+      case 8 : // *fx 151,226,8 followed by *fx 151,228,n
+               // Dump the last n (0 for all) trace entries over the UART at the next tube reset
+               tube_trace_dump_pending = val ? val : -1;
+               return;
+#endif
+#ifdef TUBE_R3_ACCEL
+      case 9 : // *fx 151,226,9 followed by *fx 151,228,0/1
+               // Turn the R3 transfer accelerator off/on (from the next transfer)
+               tube_r3_accel = val;
+               return;
+#endif
+#ifdef PROFILE6502
+      case 10 : // *fx 151,226,10 followed by *fx 151,228,n
+               // 65tube opcode profiler: 0 stop and 1 start (from the next tube reset),
+               // 2 clear the counts, 3 dump the counts over the UART at the next tube reset
+               if (val < 2) {
+                  copro_65tube_profile_enabled = val;
+               } else if (val == 2) {
+                  memset(copro_65tube_profile, 0, sizeof(copro_65tube_profile));
+               } else {
+                  copro_65tube_profile_dump_pending = 1;
+               }
+               return;
+#endif
+#ifdef PROFILE6502_PC
+      case 11 : // *fx 151,226,11 followed by *fx 151,228,n
+               // 65tube PC sampling profiler: 0 stop, 1 start, 2 clear the samples,
+               // 3 dump the samples over the UART at the next tube reset
+               if (val == 0) {
+                  copro_65tube_pc_profile_stop();
+               } else if (val == 1) {
+                  copro_65tube_pc_profile_start();
+               } else if (val == 2) {
+                  memset(&copro_65tube_pc_profile, 0, sizeof(copro_65tube_pc_profile));
+               } else {
+                  copro_65tube_pc_profile_dump_pending = 1;
+               }
+               return;
+#endif
+#ifdef COPRO_SNAPSHOT
+      case 12 : // *fx 151,226,12 followed by *fx 151,228,n
+               // Copro snapshot at the next tube reset: 1 save to flash, 2 restore
+               // from flash, 3 stream over the UART, 4 stream the one in flash
+               // over the UART (see copro-65tube.c), 0 cancel
+               copro_65tube_snapshot_pending = val;
+               return;
+#endif
+#ifdef TRACE6502
+      case 13 : // *fx 151,226,13 followed by *fx 151,228,n
+               // 65tube instruction trace: 0 stop and 1 start (from the next tube reset),
+               // 2 dump the ring over the UART at the next tube reset, or n > 2 start
+               // with the trigger set up at &n00 in the Co Pro memory (see copro-65tube.c)
+               copro_65tube_trace_command(val);
+               return;
+#endif
       default :
           break;
     }
 }
 
-static void tube_reset()
+// Reset the ULA state without flushing, for use inside a host access
+static void tube_reset_regs()
 {
+   TUBE_COUNT(resets);
+   R3_ACCEL_STOP();
+#ifdef TUBE_R3_ACCEL
+   r4_seq = 0;
+#endif
    tube_irq |= TUBE_ENABLE_BIT;
    tube_irq &= ~(RESET_BIT + NMI_BIT + IRQ_BIT);
    hp3pos = 0;
-   ph1rdpos = ph1wrpos = ph1len = 0;
+   ph1_tail = ph1_head; // the parasite owns ph1_head
    ph3pos = 1;
-   PSTAT1 = 0x40;
+   PSTAT1 = 0x00; // bit 6 comes from the R1 ring, see tube_parasite_read()
    PSTAT2 = 0x7F;
    PSTAT3 = PSTAT2;
    PSTAT4 = PSTAT2;
@@ -269,9 +688,67 @@ static void tube_reset()
    HSTAT1 |= HBIT_3 | HBIT_2 | HBIT_1;
    //tube_updateints_IRQ();
    //tube_updateints_NMI();
+}
+
+static void tube_reset()
+{
+   tube_reset_regs();
+   FLUSH_TUBE_REGS();
+}
+
+#ifdef COPRO_SNAPSHOT
+
+#if PH1_RING_SIZE != 32
+#error "tube_ula_snapshot_t needs updating for the R1 ring size"
+#endif
+
+void tube_ula_save(tube_ula_snapshot_t *s)
+{
+   ULA_LOCK();
+   memcpy(s->regs, tube_regs, 8);
+   memcpy(s->pstat, pstat, 4);
+   memcpy(s->ph1, ph1, PH1_RING_SIZE);
+   s->ph1_head = ph1_head;
+   s->ph1_tail = ph1_tail;
+   s->ph3_1 = ph3_1;
+   s->ph3pos = ph3pos;
+   s->hp1 = hp1;
+   s->hp2 = hp2;
+   s->hp3[0] = hp3[0];
+   s->hp3[1] = hp3[1];
+   s->hp4 = hp4;
+   s->hp3pos = hp3pos;
+   s->irq = tube_irq & (NMI_BIT | IRQ_BIT);
+   s->reserved = 0;
+   ULA_UNLOCK();
+}
+
+// Any R3 transfer the accelerator was servicing is left to the Tube ROM's
+// NMI handler, which is in the snapshot's memory
+void tube_ula_restore(const tube_ula_snapshot_t *s)
+{
+   ULA_LOCK();
+   R3_ACCEL_STOP();
+   memcpy(tube_regs, s->regs, 8);
+   memcpy(pstat, s->pstat, 4);
+   memcpy(ph1, s->ph1, PH1_RING_SIZE);
+   ph1_head = s->ph1_head;
+   ph1_tail = s->ph1_tail;
+   ph3_1 = s->ph3_1;
+   ph3pos = s->ph3pos;
+   hp1 = s->hp1;
+   hp2 = s->hp2;
+   hp3[0] = s->hp3[0];
+   hp3[1] = s->hp3[1];
+   hp4 = s->hp4;
+   hp3pos = s->hp3pos;
+   tube_irq = (tube_irq & ~(NMI_BIT | IRQ_BIT)) | (s->irq & (NMI_BIT | IRQ_BIT));
    FLUSH_TUBE_REGS();
+   ULA_UNLOCK();
 }
 
+#endif
+
 // 6502 Host reading the tube registers
 //
 // This function implements read-ahead, so the next values
@@ -281,24 +758,24 @@ static void tube_reset()
 //
 // Reading of status registers has no side effects, so nothing to
 // do here for even registers (all handled in the FIQ handler).
+//
+// tube_host_read_ref() and tube_host_write_ref() are the original branching
+// implementations. They are the reference that the transition tables below
+// are built to match, and are checked against on the host build.
 
-static void __time_critical_func(tube_host_read)(uint32_t addr)
+#if defined(TUBE_ULA_BRANCHY) || defined(PICO_TUBE_HOST)
+
+static void __time_critical_func(tube_host_read_ref)(uint32_t addr)
 {
    switch (addr & 7)
    {
    case 1: /*Register 1*/
-      if (ph1len > 0) {
-         PH1_0 = BYTE_TO_WORD(ph1[ph1rdpos]);
-         ph1len--;
-         if ( ph1len != 0)
-         {
-            if (ph1rdpos== 23)
-               ph1rdpos =0;
-            else
-               ph1rdpos++;
-         }
-         if (!ph1len) HSTAT1 &= ~HBIT_7;
-         PSTAT1 |= 0x40;
+      if ((HSTAT1 & HBIT_7) && ph1_head != ph1_tail) {
+         ph1_tail++;
+         if (ph1_head != ph1_tail)
+            PH1_0 = BYTE_TO_WORD(ph1[ph1_tail & PH1_RING_MASK]);
+         else
+            HSTAT1 &= ~HBIT_7;
       }
       break;
    case 3: /*Register 2*/
@@ -326,10 +803,9 @@ static void __time_critical_func(tube_host_read)(uint32_t addr)
       }
       break;
    }
-   FLUSH_TUBE_REGS();
 }
 
-static void __time_critical_func(tube_host_write)(uint32_t addr, uint8_t val)
+static void __time_critical_func(tube_host_write_ref)(uint32_t addr, uint8_t val)
 {
    switch (addr & 7)
    {
@@ -347,7 +823,7 @@ static void __time_critical_func(tube_host_write)(uint32_t addr, uint8_t val)
       if (val & 0x80) {
          // Implement software tube reset
          if (val & 0x40) {
-            tube_reset();
+            tube_reset_regs();
          } else {
             HSTAT1 |= BYTE_TO_WORD(val & 0x3F);
          }
@@ -436,80 +912,567 @@ static void __time_critical_func(tube_host_write)(uint32_t addr, uint8_t val)
       if (HSTAT1 & HBIT_2) tube_irq |= IRQ_BIT;
       break;
    }
-   FLUSH_TUBE_REGS();
 }
 
+#endif
+
+// Table driven host access
+//
+// Every host access to a FIFO register is a lookup in a transition table
+// indexed by the compact state of that FIFO (count, mode and enable bits).
+// Each entry holds the complete effect of the access: the bits to clear in
+// HSTAT, the bits to clear/set in PSTAT and tube_irq, the next FIFO count,
+// and whether the data register is reloaded. So the ISR path is a fixed
+// handful of loads and stores with no data dependent branches.
+//
+// The tables are built at start up by tube_build_tables() and are not
+// const, so they live in SRAM and the ISR never waits on XIP flash.
+
+typedef struct {
+   uint8_t hstat_and;   // applied to HSTATn
+   uint8_t pstat_and;   // applied to PSTATn
+   uint8_t pstat_or;
+   uint8_t irq_and;     // applied to tube_irq
+   uint8_t irq_or;
+   uint8_t next;        // next FIFO count
+   uint8_t load;        // host read: data register reloaded, host write: FIFO slot written
+   uint8_t step;        // host R1 read: ring read position advances
+} tube_transition_t;
+
+static tube_transition_t host_rd_r1[PH1_CAPACITY + 1]; // [bytes in the R1 ring, 0 if not published]
+static tube_transition_t host_rd_r2[2];    // [HSTAT2.7]
+static tube_transition_t host_rd_r3[8];    // [M:ph3pos]
+static tube_transition_t host_rd_r4[2];    // [HSTAT4.7]
+static tube_transition_t host_wr_r1[2];    // [I]
+static tube_transition_t host_wr_r3[16];   // [V:M:hp3pos]
+static tube_transition_t host_wr_r4[2];    // [J]
+static tube_transition_t host_wr_nmi[128]; // [ph3pos==0:hp3pos:new V:new M:old V:old M]
+static tube_transition_t host_wr_irq[32];  // [PSTAT4.7:PSTAT1.7:P:J:I]
+
+#define INDEX_R3_READ(m, ph3)            (((m) << 2) | (ph3))
+#define INDEX_R3_WRITE(v, m, hp3)        (((v) << 3) | ((m) << 2) | (hp3))
+#define INDEX_NMI(om, ov, nm, nv, hp3, z) ((om) | ((ov) << 1) | ((nm) << 2) | ((nv) << 3) | ((hp3) << 4) | ((z) << 6))
+#define INDEX_IRQ(i, j, p, p1, p4)       ((i) | ((j) << 1) | ((p) << 2) | ((p1) << 3) | ((p4) << 4))
+
+static void set_transition(tube_transition_t *t, uint8_t hstat_and, uint8_t pstat_and, uint8_t pstat_or,
+                           uint8_t irq_and, uint8_t irq_or, uint8_t next, uint8_t load)
+{
+   t->hstat_and = hstat_and;
+   t->pstat_and = pstat_and;
+   t->pstat_or  = pstat_or;
+   t->irq_and   = irq_and;
+   t->irq_or    = irq_or;
+   t->next      = next;
+   t->load      = load;
+   t->step      = 0;
+}
+
+// NMI request from R3 for the given mode and FIFO state
+static int r3_nmi_request(int v, int hp3, int ph3_empty)
+{
+   return v ? ((hp3 > 1) || ph3_empty) : ((hp3 > 0) || ph3_empty);
+}
+
+static void tube_build_tables()
+{
+   // Host reads R1: consume the byte, reload the read-ahead register from the ring
+   for (int len = 0; len <= PH1_CAPACITY; len++) {
+      tube_transition_t *t = &host_rd_r1[len];
+      set_transition(t, (len == 1) ? (uint8_t) ~HBIT_7 : 0xFF, 0xFF, 0, 0xFF, 0, 0, len > 1);
+      t->step = (len > 0);
+   }
+
+   // Host reads R2/R4: empty the one byte latch
+   set_transition(&host_rd_r2[0], 0xFF, 0xFF, 0, 0xFF, 0, 0, 0);
+   set_transition(&host_rd_r2[1], (uint8_t) ~HBIT_7, 0xFF, 0x40, 0xFF, 0, 0, 0);
+   host_rd_r4[0] = host_rd_r2[0];
+   host_rd_r4[1] = host_rd_r2[1];
+
+   // Host reads R3: shift the second byte down, NMI when empty
+   for (int m = 0; m < 2; m++) {
+      for (int ph3 = 0; ph3 < 4; ph3++) {
+         tube_transition_t *t = &host_rd_r3[INDEX_R3_READ(m, ph3)];
+         if (ph3 == 0 || ph3 > 2) {
+            set_transition(t, 0xFF, 0xFF, 0, 0xFF, 0, ph3, 0);
+         } else {
+            int empty = (ph3 == 1);
+            set_transition(t, empty ? (uint8_t) ~HBIT_7 : 0xFF, 0xFF, 0xC0,
+                           0xFF, (empty && m) ? NMI_BIT : 0, ph3 - 1, 1);
+         }
+      }
+   }
+
+   // Host writes R1/R4: IRQ if enabled
+   for (int e = 0; e < 2; e++) {
+      set_transition(&host_wr_r1[e], (uint8_t) ~HBIT_6, 0xFF, 0x80, 0xFF, e ? IRQ_BIT : 0, 0, 0);
+      host_wr_r4[e] = host_wr_r1[e];
+   }
+
+   // Host writes R3: one or two byte mode, NMI when full
+   for (int v = 0; v < 2; v++) {
+      for (int m = 0; m < 2; m++) {
+         for (int hp3 = 0; hp3 < 4; hp3++) {
+            tube_transition_t *t = &host_wr_r3[INDEX_R3_WRITE(v, m, hp3)];
+            if (v) {
+               int slot = (hp3 < 2) ? hp3 : 2;
+               int next = (hp3 < 2) ? hp3 + 1 : hp3;
+               int full = (next == 2);
+               set_transition(t, full ? (uint8_t) ~HBIT_6 : 0xFF, 0xFF, full ? 0x80 : 0,
+                              0xFF, (m && next > 1) ? NMI_BIT : 0, next, slot);
+            } else {
+               set_transition(t, (uint8_t) ~HBIT_6, 0xFF, 0x80, 0xFF, m ? NMI_BIT : 0, 1, 0);
+            }
+         }
+      }
+   }
+
+   // Host writes the control register: NMI edge and PSTAT3.7
+   for (int i = 0; i < 128; i++) {
+      int om = i & 1, ov = (i >> 1) & 1, nm = (i >> 2) & 1, nv = (i >> 3) & 1;
+      int hp3 = (i >> 4) & 3, z = (i >> 6) & 1;
+      int nmi1_m = om && r3_nmi_request(ov, hp3, z);
+      int nmi2 = r3_nmi_request(nv, hp3, z);
+      int nmi2_m = nm && nmi2;
+      tube_transition_t *t = &host_wr_nmi[i];
+      set_transition(t, 0xFF, 0x7F, nmi2 ? 0x80 : 0,
+                     nmi2_m ? 0xFF : (uint8_t) ~NMI_BIT, (!nmi1_m && nmi2_m) ? NMI_BIT : 0, 0, 0);
+   }
+
+   // Host writes the control register: RST and IRQ levels
+   for (int i = 0; i < 32; i++) {
+      int ie = i & 1, je = (i >> 1) & 1, p = (i >> 2) & 1, p1 = (i >> 3) & 1, p4 = (i >> 4) & 1;
+      int irq = (ie && p1) || (je && p4);
+      set_transition(&host_wr_irq[i], 0xFF, 0xFF, 0, (uint8_t) ~(RESET_BIT | IRQ_BIT),
+                     (p ? RESET_BIT : 0) | (irq ? IRQ_BIT : 0), 0, 0);
+   }
+}
+
+static inline void apply_irq(const tube_transition_t *t)
+{
+   tube_irq = (tube_irq & t->irq_and) | t->irq_or;
+}
+
+static void __time_critical_func(tube_host_read_tab)(uint32_t addr)
+{
+   const tube_transition_t *t;
+   uint8_t src[2];
+   uint8_t tail;
+   switch (addr & 7)
+   {
+   case 1: /*Register 1*/
+      t = &host_rd_r1[(uint8_t)(ph1_head - ph1_tail) & -(HSTAT1 >> 7)];
+      tail = ph1_tail + t->step;
+      src[0] = PH1_0;
+      src[1] = ph1[tail & PH1_RING_MASK];
+      PH1_0 = src[t->load];
+      ph1_tail = tail;
+      HSTAT1 &= t->hstat_and;
+      break;
+   case 3: /*Register 2*/
+      t = &host_rd_r2[HSTAT2 >> 7];
+      HSTAT2 &= t->hstat_and;
+      PSTAT2 |= t->pstat_or;
+      break;
+   case 5: /*Register 3*/
+      t = &host_rd_r3[INDEX_R3_READ((HSTAT1 >> 3) & 1, ph3pos)];
+      src[0] = PH3_0;
+      src[1] = PH3_1;
+      PH3_0 = src[t->load];
+      ph3pos = t->next;
+      HSTAT3 &= t->hstat_and;
+      PSTAT3 |= t->pstat_or;
+      apply_irq(t);
+      break;
+   case 7: /*Register 4*/
+      t = &host_rd_r4[HSTAT4 >> 7];
+      HSTAT4 &= t->hstat_and;
+      PSTAT4 |= t->pstat_or;
+      break;
+   }
+}
+
+static void __time_critical_func(tube_host_write_tab)(uint32_t addr, uint8_t val)
+{
+   const tube_transition_t *t;
+   switch (addr & 7)
+   {
+   case 0: /*Register 1 control/status*/
+   {
+      if (!(tube_irq & TUBE_ENABLE_BIT))
+         return;
+      uint8_t old = HSTAT1;
+      if ((val & 0xC0) == 0xC0) {
+         // Software tube reset (rare, so allowed a branch)
+         tube_reset_regs();
+      } else {
+         // bit 7 selects set or clear of the flags in bits 5..0
+         uint8_t mask = val & 0x3F;
+         HSTAT1 = (HSTAT1 & ~mask) | (mask & -(val >> 7));
+      }
+      uint8_t hstat = HSTAT1;
+      t = &host_wr_nmi[INDEX_NMI((old >> 3) & 1, (old >> 4) & 1, (hstat >> 3) & 1, (hstat >> 4) & 1,
+                                 hp3pos, ph3pos == 0)];
+      PSTAT3 = (PSTAT3 & t->pstat_and) | t->pstat_or;
+      apply_irq(t);
+      t = &host_wr_irq[INDEX_IRQ((hstat >> 1) & 1, (hstat >> 2) & 1, (hstat >> 5) & 1,
+                                 PSTAT1 >> 7, PSTAT4 >> 7)];
+      apply_irq(t);
+      break;
+   }
+   case 1: /*Register 1*/
+      t = &host_wr_r1[(HSTAT1 >> 1) & 1];
+      hp1 = val;
+      HSTAT1 &= t->hstat_and;
+      PSTAT1 |= t->pstat_or;
+      apply_irq(t);
+      break;
+   case 2:
+      copro_command = val;
+      break;
+   case 3: /*Register 2*/
+      hp2 = val;
+      PSTAT2 |=  0x80;
+      HSTAT2 &= ~HBIT_6;
+      break;
+   case 4:
+      copro_command_excute(copro_command,val);
+      break;
+   case 5: /*Register 3*/
+      t = &host_wr_r3[INDEX_R3_WRITE((HSTAT1 >> 4) & 1, (HSTAT1 >> 3) & 1, hp3pos)];
+      hp3[t->load] = val;
+      hp3pos = t->next;
+      HSTAT3 &= t->hstat_and;
+      PSTAT3 |= t->pstat_or;
+      apply_irq(t);
+      break;
+   case 6:
+      copro = val;
+      LOG_DEBUG("New Copro = %u\r\n", copro);
+      return;
+   case 7: /*Register 4*/
+      t = &host_wr_r4[(HSTAT1 >> 2) & 1];
+      hp4 = val;
+      HSTAT4 &= t->hstat_and;
+      PSTAT4 |= t->pstat_or;
+      apply_irq(t);
+      break;
+   }
+}
+
+#ifdef TUBE_ULA_BRANCHY
+#define tube_host_read  tube_host_read_ref
+#define tube_host_write tube_host_write_ref
+#else
+#define tube_host_read  tube_host_read_tab
+#define tube_host_write tube_host_write_tab
+#endif
+
+// Parasite end of R3, called with the ULA locked
+
+static inline uint8_t parasite_read_r3()
+{
+   uint8_t temp = hp3[0];
+   if (hp3pos>0)
+   {
+      CHECKSUM(para_rd, 2, temp);
+      hp3[0] = hp3[1];
+      hp3pos--;
+      if (!hp3pos)
+      {
+         HSTAT3 |=  HBIT_6;
+         PSTAT3 &= ~0x80;
+      }
+      // here we want to only clear NMI if required
+      if ( ( !(ph3pos == 0) ) && ( (!(HSTAT1 & HBIT_4) && (!(hp3pos >0))) || (HSTAT1 & HBIT_4) ) ) tube_irq &= ~NMI_BIT;
+   }
+   return temp;
+}
+
+static inline void parasite_write_r3(uint8_t val)
+{
+   if (HSTAT1 & HBIT_4)
+   {
+      if (ph3pos < 2) {
+         if (ph3pos == 0) {
+            PH3_0 = BYTE_TO_WORD(val);
+         } else {
+            PH3_1 = val;
+         }
+         ph3pos++;
+      }
+      if (ph3pos == 2)
+      {
+         HSTAT3 |=  HBIT_7;
+         PSTAT3 &= ~0xC0;
+      }
+      //NMI if other case isn't setting it
+      if (!(hp3pos > 1) ) tube_irq &= ~NMI_BIT;
+   }
+   else
+   {
+      PH3_0 = BYTE_TO_WORD(val);
+      ph3pos = 1;
+      HSTAT3 |=  HBIT_7;
+      PSTAT3 &= ~0xC0;
+      //NMI if other case isn't setting it
+      if (!(hp3pos > 0) ) tube_irq &= ~NMI_BIT;
+   }
+}
+
+#ifdef TUBE_R3_ACCEL
+
+// R3 transfer accelerator
+//
+// For a type 0-3 transfer the Tube ROM's R4 handler points the NMI vector at
+// one of its single or two byte NMI handlers, stores the transfer address
+// where that handler keeps it, then reads a sync byte from R4. After that
+// every byte (or pair) costs the 6502 an NMI, which on the emulated 6502 is
+// far more work than the byte itself.
+//
+// Once the sync byte has been read, if the NMI vector points at a handler
+// that matches the ROM's, the ULA runs the handler itself whenever a host
+// access raises the NMI: it moves the bytes between R3 and mpu_memory and
+// updates the handler's address, so the 6502 never sees the NMI but memory
+// and R3 are left exactly as if it had.
+//
+// The transfer goes back to the 6502 on the next host R4 write (the end of
+// transfer or a new one), a reset, or the parasite touching R3 itself.
+
+typedef struct {
+   uint8_t code[10];    // start of the handler
+   uint16_t match;      // bit n set if code[n] must match (operands don't)
+   uint8_t operand;     // code[] byte where the transfer address is
+   uint8_t zp;          // the transfer address is in the zero page pointer at code[operand]
+} r3_nmi_handler_t;
+
+static const r3_nmi_handler_t r3_nmi_handlers[4] = {
+   { { 0x48, 0xAD, 0x00, 0x00, 0x8D, 0xFD, 0xFE, 0xEE, 0x00, 0x00 }, 0x0F3, 2, 0 }, // LDA abs : STA &FEFD
+   { { 0x48, 0xAD, 0xFD, 0xFE, 0x8D, 0x00, 0x00, 0xEE, 0x00, 0x00 }, 0x09F, 5, 0 }, // LDA &FEFD : STA abs
+   { { 0x48, 0x98, 0x48, 0xA0, 0x00, 0xB1, 0x00, 0x8D, 0xFD, 0xFE }, 0x3BF, 6, 1 }, // LDA (zp),Y : STA &FEFD
+   { { 0x48, 0x98, 0x48, 0xA0, 0x00, 0xAD, 0xFD, 0xFE, 0x91, 0x00 }, 0x1FF, 9, 1 }, // LDA &FEFD : STA (zp),Y
+};
+
+static void r3_accel_start(int type)
+{
+   const r3_nmi_handler_t *h = &r3_nmi_handlers[type];
+   uint16_t nmi = mpu_memory[0xFFFA] | (mpu_memory[0xFFFB] << 8);
+   for (int i = 0; i < (int) sizeof(h->code); i++) {
+      if (((h->match >> i) & 1) && h->code[i] != mpu_memory[(uint16_t)(nmi + i)]) {
+         return;
+      }
+   }
+   if (h->zp) {
+      r3_accel_ptr = mpu_memory[(uint16_t)(nmi + h->operand)];
+   } else {
+      r3_accel_ptr = nmi + h->operand;
+   }
+   r3_accel_type = type;
+}
+
+// Do what the NMI handler would for a pending NMI
+static void r3_accel_nmi()
+{
+   if (!(tube_irq & NMI_BIT)) {
+      return;
+   }
+   tube_irq &= ~NMI_BIT;
+   uint16_t addr = mpu_memory[r3_accel_ptr] | (mpu_memory[(uint16_t)(r3_accel_ptr + 1)] << 8);
+   switch (r3_accel_type) {
+   case 2:
+      parasite_write_r3(mpu_memory[addr++]);
+      // fall through
+   case 0:
+      parasite_write_r3(mpu_memory[addr++]);
+      break;
+   case 3:
+      mpu_memory[addr++] = parasite_read_r3();
+      // fall through
+   case 1:
+      mpu_memory[addr++] = parasite_read_r3();
+      break;
+   }
+   mpu_memory[r3_accel_ptr] = addr;
+   mpu_memory[(uint16_t)(r3_accel_ptr + 1)] = addr >> 8;
+}
+
+// Follow the transfer commands the parasite reads from R4:
+// type, client ID, then (except for type 5) four address bytes and a sync byte
+static void r3_accel_r4(uint8_t val)
+{
+   switch (r4_seq) {
+   case 0:
+      // Bit 7 set is an error, which is followed up on R2
+      if (val < 0x80) {
+         r4_type = val;
+         r4_seq = 1;
+      }
+      break;
+   case 1:
+      r4_seq = (r4_type == 5) ? 0 : 2;
+      break;
+   default:
+      if (++r4_seq == 7) {
+         r4_seq = 0;
+         if (r4_type < 4 && tube_r3_accel) {
+            r3_accel_start(r4_type);
+            r3_accel_nmi();
+         }
+      }
+      break;
+   }
+}
+
+#endif
+
+static inline uint8_t parasite_status(uint32_t addr)
+{
+   uint8_t temp;
+   switch (addr & 6)
+   {
+   case 0: /*Register 1 stat*/
+      temp = (PSTAT1 & 0x80) | (WORD_TO_BYTE(HSTAT1) & 0x3F);
+      if ((uint8_t)(ph1_head - ph1_tail) < PH1_CAPACITY)
+         temp |= 0x40;
+      return temp;
+   case 2: /*Register 2 stat*/
+      return PSTAT2;
+   case 4: /*Register 3 stat*/
+      return PSTAT3;
+   default: /*Register 4 stat*/
+      return PSTAT4;
+   }
+}
+
+#ifdef TUBE_IDLE_WFE
+
+// Idle detection for the 6502's status polling loops
+//
+// The client waits for the host in loops that only read status registers
+// (LDA &FEF8:BPL, BIT &FEFA:BVC, or the Tube ROM's idle loop reading R1 and
+// R4 in turn). Only a host access can change what they read, and that
+// interrupts this core (with USE_ULA_CORE, core1 signals an event). So once
+// IDLE_POLLS status reads in a row have each read the same as last time,
+// the next waits for an event before reading. The 6502 sees the same values;
+// the wait is also cut short after IDLE_WAIT_US, which keeps loops with a
+// timeout polling at about the rate a real 6502 would.
+
+#define IDLE_POLLS   8
+#define IDLE_WAIT_US 4
+
+uint32_t tube_idle_waits;
+static uint8_t idle_status[4];
+static uint8_t idle_polls;
+
+#ifndef PICO_TUBE_HOST
+
+#include "hardware/timer.h"
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+
+// The alarm is enabled in the timer but not in the NVIC: with SEVONPEND,
+// its interrupt going pending wakes the WFE without a handler
+#define IDLE_ALARM 2
+
+static void tube_idle_init()
+{
+   hardware_alarm_claim(IDLE_ALARM);
+   timer_hw->inte |= 1u << IDLE_ALARM;
+   scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
+}
+
+void __time_critical_func(tube_idle_wait)()
+{
+   timer_hw->alarm[IDLE_ALARM] = timer_hw->timerawl + IDLE_WAIT_US;
+   __wfe();
+   timer_hw->armed = 1u << IDLE_ALARM;
+   timer_hw->intr = 1u << IDLE_ALARM;
+   irq_clear(TIMER_IRQ_0 + IDLE_ALARM);
+}
+
+#endif
+
+static inline uint8_t idle_status_read(uint32_t addr)
+{
+   uint8_t *last = &idle_status[(addr >> 1) & 3];
+   uint8_t temp = parasite_status(addr);
+   if (temp != *last) {
+      *last = temp;
+      idle_polls = 0;
+   } else if (++idle_polls >= IDLE_POLLS) {
+      idle_polls = IDLE_POLLS;
+      tube_idle_waits++;
+      tube_idle_wait();
+      temp = parasite_status(addr);
+      if (temp != *last) {
+         *last = temp;
+         idle_polls = 0;
+      }
+   }
+   return temp;
+}
+
+#define STATUS_READ(addr) idle_status_read(addr)
+#define IDLE_RESET()      (idle_polls = 0)
+
+#else
+
+#define STATUS_READ(addr) parasite_status(addr)
+#define IDLE_RESET()
+
+#endif
+
 uint8_t __time_critical_func(tube_parasite_read)(uint32_t addr)
 {
 
    uint8_t temp ;
+   TUBE_COUNT(parasite_reads[addr & 7]);
+   if (!(addr & 1)) {
+      return STATUS_READ(addr);
+   }
+   IDLE_RESET();
+   ULA_LOCK();
    switch (addr & 7)
    {
-   case 0: /*Register 1 stat*/
-      temp = PSTAT1 | (WORD_TO_BYTE(HSTAT1) & 0x3F);
-      break;
    case 1: /*Register 1*/
-       _disable_interrupts();
       temp = hp1;
       if (PSTAT1 & 0x80)
       {
+         CHECKSUM(para_rd, 0, temp);
          PSTAT1 &= ~0x80;
          HSTAT1 |=  HBIT_6;
          if (!(PSTAT4 & 128)) tube_irq &= ~IRQ_BIT;
       }
-      _enable_interrupts();
-      break;
-   case 2: /*Register 2 stat*/
-      temp = PSTAT2;
       break;
    case 3: /*Register 2*/
-       _disable_interrupts();
       temp = hp2;
       if (PSTAT2 & 0x80)
       {
+         CHECKSUM(para_rd, 1, temp);
          PSTAT2 &= ~0x80;
          HSTAT2 |=  HBIT_6;
       }
-      _enable_interrupts();
-      break;
-   case 4: /*Register 3 stat*/
-      temp = PSTAT3;
       break;
    case 5: /*Register 3*/
-      _disable_interrupts();
-      temp = hp3[0];
-      if (hp3pos>0)
-      {
-         hp3[0] = hp3[1];
-         hp3pos--;
-         if (!hp3pos)
-         {
-            HSTAT3 |=  HBIT_6;
-            PSTAT3 &= ~0x80;
-         }
-         // here we want to only clear NMI if required
-         if ( ( !(ph3pos == 0) ) && ( (!(HSTAT1 & HBIT_4) && (!(hp3pos >0))) || (HSTAT1 & HBIT_4) ) ) tube_irq &= ~NMI_BIT;
-      }
-      _enable_interrupts();
+      R3_ACCEL_STOP();
+      temp = parasite_read_r3();
       break;
-   case 6: /*Register 4 stat*/
-      temp = PSTAT4;
-      break;
-   case 7: /*Register 4*/
-       _disable_interrupts();
+   default: /*Register 4 (the even addresses returned above)*/
       temp = hp4;
       if (PSTAT4 & 0x80)
       {
+         CHECKSUM(para_rd, 3, temp);
          PSTAT4 &= ~0x80;
          HSTAT4 |=  HBIT_6;
          if (!(PSTAT1 & 128)) tube_irq &= ~IRQ_BIT;
+#ifdef TUBE_R3_ACCEL
+         r3_accel_r4(temp);
+#endif
       }
-      _enable_interrupts();
       break;
    }
-   if (addr & 1) {
-      FLUSH_TUBE_REGS();
-   }
+   FLUSH_TUBE_REGS();
+   ULA_UNLOCK();
+   TRACE(TRACE_PARASITE, (addr & 7) | TRACE_READ, temp);
    return temp;
 }
 
@@ -521,64 +1484,68 @@ void tube_parasite_write_banksel(uint32_t addr, uint8_t val)
 
 }
 
+// Load PH1_0 when the host has emptied it and the ring has more data.
+//
+// This runs as its own interrupt at the same priority as the ULA interrupt,
+// so it is never interleaved with a host access and may update HSTAT1.
+
+static void __time_critical_func(tube_ph1_publish)()
+{
+   if (!(HSTAT1 & HBIT_7) && ph1_head != ph1_tail) {
+      PH1_0 = BYTE_TO_WORD(ph1[ph1_tail & PH1_RING_MASK]);
+      HSTAT1 |= HBIT_7;
+      FLUSH_TUBE_REGS();
+   }
+}
+
+// R1 is the busiest parasite write (all VDU output), so it doesn't mask
+// interrupts. The byte is added to the ring and only if the host side
+// register is empty is the publish interrupt raised to load it.
+
+static inline void tube_parasite_write_r1(uint8_t val)
+{
+   uint8_t head = ph1_head;
+   TUBE_COUNT(r1_depth[(uint8_t)(head - ph1_tail)]);
+   if ((uint8_t)(head - ph1_tail) < PH1_CAPACITY)
+   {
+      ph1[head & PH1_RING_MASK] = val;
+      __compiler_memory_barrier();
+      ph1_head = head + 1;
+#ifndef USE_ULA_CORE
+      // (the ULA core polls for this instead)
+      if (!(HSTAT1 & HBIT_7))
+         irq_set_pending(ph1_publish_irq);
+#endif
+   }
+}
+
 void __time_critical_func(tube_parasite_write)(uint32_t addr, uint8_t val)
 {
-   _disable_interrupts();
+   TUBE_COUNT(parasite_writes[addr & 7]);
+   IDLE_RESET();
+#ifdef DEBUG_TRANSFERS
+   if (addr & 1) {
+      CHECKSUM(para_wr, (addr >> 1) & 3, val);
+   }
+#endif
+   if ((addr & 7) == 1) {
+      tube_parasite_write_r1(val);
+      TRACE(TRACE_PARASITE, 1, val);
+      return;
+   }
+
+   ULA_LOCK();
 
    switch (addr & 7)
    {
-   case 1: /*Register 1*/
-      if (ph1len < 24)
-      {
-         if (ph1len == 0) {
-            PH1_0 = BYTE_TO_WORD(val);
-         } else {
-            ph1[ph1wrpos] = val;
-            if (ph1wrpos== 23)
-               ph1wrpos =0;
-            else
-               ph1wrpos++;
-         }
-
-         ph1len++;
-         HSTAT1 |= HBIT_7;
-         if (ph1len == 24) PSTAT1 &= ~0x40;
-      }
-      break;
    case 3: /*Register 2*/
       PH2 = BYTE_TO_WORD(val);
       HSTAT2 |=  HBIT_7;
       PSTAT2 &= ~0x40;
       break;
    case 5: /*Register 3*/
-      if (HSTAT1 & HBIT_4)
-      {
-         if (ph3pos < 2) {
-            if (ph3pos == 0) {
-               PH3_0 = BYTE_TO_WORD(val);
-            } else {
-               PH3_1 = val;
-            }
-            ph3pos++;
-         }
-         if (ph3pos == 2)
-         {
-            HSTAT3 |=  HBIT_7;
-            PSTAT3 &= ~0xC0;
-         }
-         //NMI if other case isn't setting it
-         if (!(hp3pos > 1) ) tube_irq &= ~NMI_BIT;
-      }
-      else
-      {
-         PH3_0 = BYTE_TO_WORD(val);
-         ph3pos = 1;
-         HSTAT3 |=  HBIT_7;
-         PSTAT3 &= ~0xC0;
-         //NMI if other case isn't setting it
-         if (!(hp3pos > 0) ) tube_irq &= ~NMI_BIT;
-      }
-
+      R3_ACCEL_STOP();
+      parasite_write_r3(val);
       break;
    case 7: /*Register 4*/
       PH4 = BYTE_TO_WORD(val);
@@ -587,30 +1554,244 @@ void __time_critical_func(tube_parasite_write)(uint32_t addr, uint8_t val)
       break;
    }
    FLUSH_TUBE_REGS();
-   _enable_interrupts();
+   ULA_UNLOCK();
+   TRACE(TRACE_PARASITE, addr & 7, val);
 }
 
-// Returns bit 0 set if IRQ is asserted by the tube
-// Returns bit 1 set if NMI is asserted by the tube
-// Returns bit 2 set if RST is asserted by the host or tube
+#ifdef PICO_TUBE_HOST
 
-void __time_critical_func(tube_io_handler)(uint32_t mail)
+// Complete ULA state, for checking the transition tables against the reference
+
+typedef struct {
+   uint8_t regs[8];
+   uint8_t pstat[4];
+   uint8_t ph1[PH1_RING_SIZE];
+   uint8_t ph3_1;
+   uint8_t hp1, hp2, hp3[2], hp4;
+   uint8_t ph3pos, hp3pos, ph1_head, ph1_tail;
+   int irq;
+   unsigned int copro;
+   unsigned int copro_speed;
+   char copro_command;
+} ula_state_t;
+
+static void ula_save(ula_state_t *st)
+{
+   memset(st, 0, sizeof(*st));
+   memcpy(st->regs, tube_regs, 8);
+   memcpy(st->pstat, pstat, 4);
+   memcpy(st->ph1, ph1, PH1_RING_SIZE);
+   st->ph3_1 = ph3_1;
+   st->hp1 = hp1;
+   st->hp2 = hp2;
+   st->hp3[0] = hp3[0];
+   st->hp3[1] = hp3[1];
+   st->hp4 = hp4;
+   st->ph3pos = ph3pos;
+   st->hp3pos = hp3pos;
+   st->ph1_head = ph1_head;
+   st->ph1_tail = ph1_tail;
+   st->irq = tube_irq;
+   st->copro = copro;
+   st->copro_speed = copro_speed;
+   st->copro_command = copro_command;
+}
+
+static void ula_restore(const ula_state_t *st)
+{
+   memcpy(tube_regs, st->regs, 8);
+   memcpy(pstat, st->pstat, 4);
+   memcpy(ph1, st->ph1, PH1_RING_SIZE);
+   ph3_1 = st->ph3_1;
+   hp1 = st->hp1;
+   hp2 = st->hp2;
+   hp3[0] = st->hp3[0];
+   hp3[1] = st->hp3[1];
+   hp4 = st->hp4;
+   ph3pos = st->ph3pos;
+   hp3pos = st->hp3pos;
+   ph1_head = st->ph1_head;
+   ph1_tail = st->ph1_tail;
+   tube_irq = st->irq;
+   copro = st->copro;
+   copro_speed = st->copro_speed;
+   copro_command = st->copro_command;
+}
+
+// Run every host access against every combination of the state the tables
+// are indexed by (plus pseudo random values for everything else) through
+// both implementations, and compare the resulting ULA state.
+//
+// Returns the number of mismatches.
+
+int tube_verify_tables()
+{
+   static const uint8_t lens[] = { 0, 1, 2, 12, 23, 24 };
+   ula_state_t start, ref, tab;
+   uint32_t seed = 1;
+   int errors = 0;
+   long checks = 0;
+
+   tube_build_tables();
+
+   for (int hstat1 = 0; hstat1 < 64; hstat1++)
+   for (int l = 0; l < (int) sizeof(lens); l++)
+   for (int fifo3 = 0; fifo3 < 9; fifo3++)
+   for (int flags = 0; flags < 64; flags++) {
+      // Pseudo random background state
+      for (int i = 0; i < 8; i++) {
+         seed = seed * 1103515245 + 12345;
+         tube_regs[i] = seed >> 16;
+      }
+      for (int i = 0; i < PH1_RING_SIZE; i++) {
+         seed = seed * 1103515245 + 12345;
+         ph1[i] = seed >> 16;
+      }
+      seed = seed * 1103515245 + 12345;
+      ph1_tail = seed >> 16;
+      ph1_head = ph1_tail + lens[l];
+      hp3pos = fifo3 % 3;
+      ph3pos = fifo3 / 3;
+      ph3_1 = seed >> 8;
+      hp1 = hp2 = hp4 = hp3[0] = hp3[1] = seed;
+      HSTAT1 = (HSTAT1 & 0xC0) | hstat1;
+      PSTAT1 = (flags & 1) ? 0x80 : 0;
+      PSTAT4 = ((flags & 2) ? 0x80 : 0) | (seed & 0x7F);
+      PSTAT2 = seed >> 24;
+      PSTAT3 = seed >> 16;
+      tube_irq = (flags >> 2) & (TUBE_ENABLE_BIT | RESET_BIT | NMI_BIT | IRQ_BIT);
+      ula_save(&start);
+
+      for (unsigned int access = 0; access < 16 + 255; access++) {
+         int rnw = access < 8;
+         int addr = (access < 16) ? access & 7 : 0;
+         // Copro selection exits the tube emulation, so not worth comparing
+         if (!rnw && (addr == 6 || addr == 4)) {
+            continue;
+         }
+         uint8_t val = (access < 16) ? seed >> 8 : access - 16;
+
+         ula_restore(&start);
+         if (rnw) tube_host_read_ref(addr); else tube_host_write_ref(addr, val);
+         ula_save(&ref);
+
+         ula_restore(&start);
+         if (rnw) tube_host_read_tab(addr); else tube_host_write_tab(addr, val);
+         ula_save(&tab);
+
+         checks++;
+         if (memcmp(&ref, &tab, sizeof(ref))) {
+            if (errors++ < 10) {
+               printf("mismatch: %s %d val %02x HSTAT1 %02x ph1 %d hp3pos %d ph3pos %d irq %02x\r\n",
+                      rnw ? "read" : "write", addr, val, start.regs[0], (uint8_t)(start.ph1_head - start.ph1_tail),
+                      start.hp3pos, start.ph3pos, start.irq);
+            }
+         }
+      }
+   }
+   ula_restore(&start);
+   tube_reset();
+   printf("%ld host accesses checked, %d mismatches\r\n", checks, errors);
+   return errors;
+}
+
+// The four parasite status registers, read without counting as 6502 polls
+uint32_t tube_parasite_status_peek()
+{
+   return parasite_status(0) | (parasite_status(2) << 8) | (parasite_status(4) << 16) | (parasite_status(6) << 24);
+}
+
+#endif
+
+// One host bus access, leaving the PIO register mirror for the caller to flush
+
+static inline void tube_host_access(uint32_t mail)
 {
+#ifdef TUBE_COUNTERS
+   int irq = tube_irq;
+   uint8_t hstat1 = HSTAT1;
+#endif
    if (((mail >> NRST_PIN) & 1) == 0)        // Check for Reset
    {
+      TRACE(TRACE_HOST, TRACE_RESET, 0);
       tube_irq |= RESET_BIT;
+      R3_ACCEL_STOP();
    }
    else
    {
       uint32_t addr = (mail>>A0_PIN) & 7;
       if ( ( (mail >>RNW_PIN ) & 1) == 0) {  // Check read write flag
+         TUBE_COUNT(host_writes[addr]);
+#ifdef DEBUG_TRANSFERS
+         if (addr & 1) {
+            CHECKSUM(host_wr, addr >> 1, mail);
+         }
+#endif
          tube_host_write(addr, mail );
+         TRACE(TRACE_HOST, addr, mail);
+         TUBE_COUNT(r3_mode[((hstat1 ^ HSTAT1) >> 4) & 1]);
       } else {
+         TUBE_COUNT(host_reads[addr]);
+#ifdef DEBUG_TRANSFERS
+         // The host got whatever was in the data register, which was only
+         // a transfer if the status said there was data
+         if ((addr & 1) && (tube_regs[addr - 1] & HBIT_7)) {
+            CHECKSUM(host_rd, addr >> 1, tube_regs[addr]);
+         }
+#endif
+         TRACE(TRACE_HOST, addr | TRACE_READ, tube_regs[addr]);
          tube_host_read(addr);
       }
+#ifdef TUBE_R3_ACCEL
+      if (r3_accel_type >= 0) {
+         // A host R4 write ends the transfer
+         if (addr == 7 && ((mail >> RNW_PIN) & 1) == 0) {
+            R3_ACCEL_STOP();
+         } else {
+            r3_accel_nmi();
+         }
+      }
+#endif
    }
+   TUBE_COUNT(raised[tube_irq & ~irq & (IRQ_BIT | NMI_BIT)]);
 }
 
+// Returns bit 0 set if IRQ is asserted by the tube
+// Returns bit 1 set if NMI is asserted by the tube
+// Returns bit 2 set if RST is asserted by the host or tube
+
+void __time_critical_func(tube_io_handler)(uint32_t mail)
+{
+   tube_host_access(mail);
+   FLUSH_TUBE_REGS();
+}
+
+#ifdef USE_PIO_DMA
+
+// Called by picofifo in place of a single tube_io_handler(). The PIO
+// register mirror is flushed once per batch, as the host has already made
+// every access in it.
+
+void __time_critical_func(tube_drain_bus_ring)()
+{
+   uint32_t depth;
+   do {
+      while ((depth = bus_ring_depth()) != 0) {
+         if (depth > tube_ring_stats.high_water)
+            tube_ring_stats.high_water = depth;
+         tube_host_access(bus_ring[bus_ring_rd]);
+         bus_ring_rd = (bus_ring_rd + 1) & (BUS_RING_SIZE - 1);
+         tube_ring_stats.samples++;
+      }
+      FLUSH_TUBE_REGS();
+      // The samples just handled will each have left the interrupt pending
+      irq_clear(PIO0_IRQ_0);
+   } while (bus_ring_depth());
+   tube_ring_stats.batches++;
+}
+
+#endif
+
 
 void tube_init_hardware()
 {
@@ -640,6 +1821,19 @@ void tube_init_hardware()
 
    hp1 = hp2 = hp4 = hp3[0]= hp3[1]=0;
 
+   tube_build_tables();
+
+#ifdef USE_ULA_CORE
+   spin_lock_claim(ULA_SPINLOCK_ID);
+   ula_lock = spin_lock_init(ULA_SPINLOCK_ID);
+   spin_lock_claim(ULA_EVENT_SPINLOCK_ID);
+   ula_event_lock = spin_lock_init(ULA_EVENT_SPINLOCK_ID);
+#endif
+
+#if defined(TUBE_IDLE_WFE) && !defined(PICO_TUBE_HOST)
+   tube_idle_init();
+#endif
+
 }
 
 int tube_is_rst_active() {
@@ -666,6 +1860,10 @@ int tube_is_rst_active() {
 
 void tube_wait_for_rst_release() {
    volatile int i;
+#ifdef USE_PIO_DMA
+   LOG_DEBUG("Bus sample ring: %"PRIu32" samples in %"PRIu32" batches, high water %"PRIu32" of %u\r\n",
+             tube_ring_stats.samples, tube_ring_stats.batches, tube_ring_stats.high_water, BUS_RING_SIZE);
+#endif
    do {
       // Wait for reset to be released
       while (tube_is_rst_active());
@@ -673,21 +1871,169 @@ void tube_wait_for_rst_release() {
       for (i = 0; i < DEBOUNCE_TIME && !tube_is_rst_active(); i++);
       // Loop back if we exit the debouce loop prematurely because RST has gone active again
    } while (i < DEBOUNCE_TIME);
+#ifdef TUBE_COUNTERS
+   if (tube_counters_dump_pending) {
+      tube_counters_dump_pending = 0;
+      tube_dump_counters();
+   }
+#endif
+#ifdef DEBUG_TUBE
+   if (tube_trace_dump_pending) {
+      tube_trace_dump(tube_trace_dump_pending < 0 ? 0 : tube_trace_dump_pending);
+      tube_trace_dump_pending = 0;
+   }
+#endif
+#ifdef DEBUG_TRANSFERS
+   if (tube_transfer_sums_dump_pending) {
+      tube_transfer_sums_dump_pending = 0;
+      tube_dump_transfer_sums();
+   }
+#endif
    // Reset all the TUBE ULA registers
+   ULA_LOCK();
    tube_reset();
+   ULA_UNLOCK();
 }
 
 void disable_tube() {
    int i;
+   ULA_LOCK();
    tube_irq &= ~TUBE_ENABLE_BIT;
    for (i = 0; i < 8; i++) {
       tube_regs[i] = 0xfe;
    }
+   FLUSH_TUBE_REGS();
+   ULA_UNLOCK();
+}
+
+#if defined(USE_ULA_CORE) || defined(PICO_TUBE_HOST)
+
+// ULA core mode (USE_ULA_CORE)
+//
+// Core1 services the PIO bus samples itself, so a host access no longer
+// interrupts the 6502 on core0. Core0 is only interrupted, through the SIO
+// FIFO, when a sample raises a new RESET/NMI/IRQ event while the fast 6502
+// is running, so that it can flip its instruction table to the event
+// handlers. A level that is already raised has already been signalled, and
+// CLI/PLP/RTI check tube_irq themselves.
+//
+// The events are ORed into ula_core_events and the FIFO is only a doorbell.
+// If the FIFO is full the doorbell is skipped, as core0 still has doorbells
+// to read and takes the events after draining them, so none are dropped.
+//
+// Returns non-zero if core0 was signalled.
+
+#ifdef USE_ULA_CORE
+
+static volatile uint32_t ula_core_events;
+
+static inline void SIGNAL_CORE0(uint32_t events)
+{
+   spin_lock_unsafe_blocking(ula_event_lock);
+   ula_core_events |= events;
+   spin_unlock_unsafe(ula_event_lock);
+   if (multicore_fifo_wready()) {
+      sio_hw->fifo_wr = events;
+   }
+}
+
+// Called by picofifo on core0, returns the events raised since the last call
+uint32_t __time_critical_func(tube_ula_core_take_events)()
+{
+   uint32_t events;
+   // Drain the doorbells first, so that one rung after this still finds its
+   // events waiting
+   while (multicore_fifo_rvalid()) {
+      (void) sio_hw->fifo_rd;
+   }
+   multicore_fifo_clear_irq();
+   spin_lock_unsafe_blocking(ula_event_lock);
+   events = ula_core_events;
+   ula_core_events = 0;
+   spin_unlock_unsafe(ula_event_lock);
+   return events;
 }
 
+#else
+#define SIGNAL_CORE0(events)
+#endif
+
+// Wakes core0 if it is waiting in tube_idle_wait() on a status register
+#if defined(USE_ULA_CORE) && defined(TUBE_IDLE_WFE)
+#define WAKE_CORE0() __sev()
+#else
+#define WAKE_CORE0()
+#endif
+
+int __time_critical_func(tube_ula_core_service)(uint32_t mail)
+{
+   ULA_LOCK();
+   int before = tube_irq;
+   tube_io_handler(mail);
+   int after = tube_irq;
+   ULA_UNLOCK();
+   WAKE_CORE0();
+   if (!(after & FAST6502_BIT) || !(after & ~before & (RESET_BIT | NMI_BIT | IRQ_BIT))) {
+      return 0;
+   }
+   SIGNAL_CORE0(after & ~before & (RESET_BIT | NMI_BIT | IRQ_BIT));
+   return 1;
+}
+
+#endif
+
+#ifdef USE_ULA_CORE
+
+#ifdef COPRO_SNAPSHOT
+// Set while core0 writes the flash, which core1 must keep out of
+static volatile int ula_core_park, ula_core_parked;
+
+void tube_ula_core_park(int park)
+{
+   ula_core_park = park;
+   while (ula_core_parked != park);
+}
+#endif
+
+static void __time_critical_func(tube_ula_core)()
+{
+   for (;;) {
+      __compiler_memory_barrier();
+      if (!pio_sm_is_rx_fifo_empty(pio0, 3)) {
+         tube_ula_core_service(pio_sm_get(pio0, 3));
+      } else if (!(HSTAT1 & HBIT_7) && ph1_head != ph1_tail) {
+         ULA_LOCK();
+         tube_ph1_publish();
+         ULA_UNLOCK();
+         WAKE_CORE0();
+#ifdef COPRO_SNAPSHOT
+      } else if (ula_core_park) {
+         ula_core_parked = 1;
+         while (ula_core_park);
+         ula_core_parked = 0;
+#endif
+      }
+   }
+}
+
+#endif
+
 void start_ula()
 {
-#ifdef USE_PIO
+#ifdef USE_ULA_CORE
+   // Core1 must be running before core0 takes the SIO FIFO interrupt
+   multicore_launch_core1(tube_ula_core);
+   irq_set_exclusive_handler(SIO_IRQ_PROC0, picofifo);
+   irq_set_enabled(SIO_IRQ_PROC0, true);
+#else
+   ph1_publish_irq = user_irq_claim_unused(true);
+   irq_set_exclusive_handler(ph1_publish_irq, tube_ph1_publish);
+   irq_set_enabled(ph1_publish_irq, true);
+#endif
+
+#if defined(USE_ULA_CORE)
+   // Bus samples are read by core1, so PIO0_IRQ_0 stays disabled
+#elif defined(USE_PIO)
    irq_set_exclusive_handler(PIO0_IRQ_0, picofifo);
    irq_set_enabled(PIO0_IRQ_0, true);
    pio0->inte0 = PIO_IRQ0_INTE_SM3_RXNEMPTY_BITS;
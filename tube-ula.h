@@ -10,9 +10,20 @@
 // Uncomment to checksum tube transfers
 // #define DEBUG_TRANSFERS
 
-// Uncomment to log all tube FIFO reads/writes (excluding status only)
+// Uncomment to log all tube FIFO reads/writes (excluding status only) into a RAM trace
 // #define DEBUG_TUBE
 
+// Uncomment to use the original branching host access logic instead of the transition tables
+// #define TUBE_ULA_BRANCHY
+
+// Uncomment to count tube traffic (see copro_command_excute() for reading the counters)
+// #define TUBE_COUNTERS
+
+// Uncomment to have the ULA move type 0-3 R3 transfer bytes to/from 6502
+// memory itself, instead of the Tube ROM's NMI handlers (this adds work to
+// the host access ISR)
+// #define TUBE_R3_ACCEL
+
 extern volatile int tube_irq;
 
 extern void disable_tube();
@@ -43,4 +54,124 @@ extern void tube_wait_for_rst_release();
 
 extern void start_ula();
 
+// PIO register mirror flush counters (TUBE_COUNTERS, and the host build)
+typedef struct {
+   uint32_t requests;   // calls to FLUSH_TUBE_REGS()
+   uint32_t pushes[2];  // words pushed to PIO1 SM2 (regs 0..3) and SM3 (regs 4..7)
+} tube_flush_stats_t;
+
+extern tube_flush_stats_t tube_flush_stats;
+
+// PIO bus sample ring counters (USE_PIO_DMA)
+typedef struct {
+   uint32_t samples;    // bus samples handled
+   uint32_t batches;    // ISR entries that found samples to handle
+   uint32_t high_water; // deepest the ring has been
+} tube_ring_stats_t;
+
+#ifdef USE_PIO_DMA
+extern tube_ring_stats_t tube_ring_stats;
+
+extern void tube_drain_bus_ring();
+#endif
+
+// Tube traffic counters (TUBE_COUNTERS)
+//
+// Exactly one page, so copro command 2 can copy it into 6502 memory as is.
+// The R1 FIFO high water mark is the highest non zero r1_depth[] entry.
+typedef struct {
+   uint32_t host_reads[8];      // posted host reads per address (odd addresses only)
+   uint32_t host_writes[8];
+   uint32_t parasite_reads[8];
+   uint32_t parasite_writes[8];
+   uint32_t r1_depth[25];       // parasite R1 writes by bytes already in the FIFO
+   uint32_t raised[4];          // host accesses raising [1] IRQ [2] NMI [3] both
+   uint32_t r3_mode[2];         // host writes [1] changing the R3 mode (V)
+   uint32_t resets;             // nRST and software resets
+} tube_counters_t;
+
+#ifdef TUBE_COUNTERS
+extern tube_counters_t tube_counters;
+
+extern void tube_dump_counters();
+#endif
+
+// Tube transfer checksums (DEBUG_TRANSFERS)
+//
+// Each byte b moved through a data register adds to its channel:
+//   count += 1; sum1 = (sum1 + b) & 0xFFFF; sum2 = (sum2 + sum1) & 0xFFFF
+// Every direction is summed at both ends, so a dropped or duplicated byte
+// shows as the two ends disagreeing, and the host end can be compared with
+// the same sums worked out by a program on the BBC.
+typedef struct {
+   uint32_t count;
+   uint16_t sum1;
+   uint16_t sum2;
+} tube_checksum_t;
+
+typedef struct {
+   tube_checksum_t host_wr[4];  // R1-R4 bytes written by the host
+   tube_checksum_t para_rd[4];  // R1-R4 bytes read by the parasite
+   tube_checksum_t para_wr[4];  // R1-R4 bytes written by the parasite
+   tube_checksum_t host_rd[4];  // R1-R4 bytes read by the host
+} tube_transfer_sums_t;
+
+#ifdef DEBUG_TRANSFERS
+extern tube_transfer_sums_t tube_transfer_sums;
+
+extern void tube_dump_transfer_sums();
+#endif
+
+#ifdef DEBUG_TUBE
+extern void tube_trace_dump(int n);
+#endif
+
+#ifdef TUBE_R3_ACCEL
+extern int tube_r3_accel;
+#endif
+
+#if defined(USE_ULA_CORE) || defined(PICO_TUBE_HOST)
+extern int tube_ula_core_service(uint32_t mail);
+#endif
+
+#ifdef USE_ULA_CORE
+extern uint32_t tube_ula_core_take_events();
+#endif
+
+#ifdef TUBE_IDLE_WFE
+extern uint32_t tube_idle_waits;
+
+extern void tube_idle_wait();
+#endif
+
+#ifdef COPRO_SNAPSHOT
+// The ULA's registers and FIFOs, as kept in a copro snapshot (copro-65tube.h)
+typedef struct {
+   uint8_t regs[8];      // tube_regs[], the host side view
+   uint8_t pstat[4];
+   uint8_t ph1[32];      // the parasite to host R1 ring
+   uint8_t ph1_head, ph1_tail;
+   uint8_t ph3_1, ph3pos;
+   uint8_t hp1, hp2, hp3[2], hp4, hp3pos;
+   uint8_t irq;          // NMI_BIT and IRQ_BIT of tube_irq
+   uint8_t reserved;
+} tube_ula_snapshot_t;
+
+extern void tube_ula_save(tube_ula_snapshot_t *s);
+
+// Call after tube_wait_for_rst_release(), which resets the ULA
+extern void tube_ula_restore(const tube_ula_snapshot_t *s);
+
+#ifdef USE_ULA_CORE
+// Keeps core1 out of the flash (1) or lets it go (0)
+extern void tube_ula_core_park(int park);
+#endif
+#endif
+
+#ifdef PICO_TUBE_HOST
+extern int tube_verify_tables();
+
+extern uint32_t tube_parasite_status_peek();
+#endif
+
 #endif